@@ -1,95 +1,308 @@
 /*
  * sha_benchmark.cpp
  *
- * This file benchmarks various SHA (Secure Hash Algorithm) functions by measuring
- * their execution time for hashing a fixed input data string. The file includes:
+ * This file benchmarks the SHA (Secure Hash Algorithm) functions of `sha.h`
+ * across a sweep of message sizes. For every algorithm, every compression
+ * backend the CPU supports and every message size it:
  *
- * - The `BENCHMARK` macro: A utility to measure and display the time taken for
- *   code execution in nanoseconds.
- * - SHA256: Benchmarks the SHA-256 hashing function.
- * - SHA224: Benchmarks the SHA-224 hashing function.
- * - SHA512: Benchmarks the SHA-512 hashing function.
- * - SHA384: Benchmarks the SHA-384 hashing function.
- * - SHA512_224: Benchmarks the SHA-512/224 hashing function.
- * - SHA512_256: Benchmarks the SHA-512/256 hashing function.
+ * - warms up the code path and the input buffer,
+ * - collects timed samples until a time budget is spent, each sample hashing
+ *   the message often enough to be well above the timer resolution,
+ * - reports the median and 99th percentile latency of one hash, the median
+ *   throughput in GB/s and, on x86, the median cycles per byte measured with
+ *   rdtsc (reference cycles, which match core cycles at the base clock).
  *
- * The `main` function creates instances of each SHA class, computes the hash for
- * a fixed input data string, and prints the hash values along with the time
- * taken for each algorithm.
+ * Results are printed as a table, or as CSV or JSON for tracking regressions
+ * between releases. Run with --help for the options.
  *
- * This file relies on the `sha.h` header for the SHA implementations and requires
- * compilation with C++11 or later. The results are output to the console showing
- * the computed hash values and their respective processing times.
+ * This file relies on the `sha.h` header for the SHA implementations and
+ * requires compilation with C++11 or later.
  */
 
-#include <iostream>
+#include <algorithm>
 #include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
 #include <string>
+#include <vector>
 
 #include "sha.h"  // Include SHA implementation
 
-// Macro to benchmark code execution time
-#define BENCHMARK(code) { \
-    auto start = std::chrono::high_resolution_clock::now(); \
-    code; \
-    auto end = std::chrono::high_resolution_clock::now(); \
-    auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start); \
-    std::cout << "Elapsed time: " << duration.count() << " ns\n\n" << std::endl; \
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define SHA_BENCHMARK_HAVE_RDTSC 1
+#endif
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Command line settings.
+struct Options {
+    size_t min_size = 16;
+    size_t max_size = size_t(1) << 30;
+    double budget = 0.2;  // Seconds of samples per size.
+    std::string format = "table";
+    std::string algorithms = "all";
+    bool all_backends = true;
+};
+
+// The statistics of one (algorithm, backend, size) configuration.
+struct Result {
+    const char* algorithm;
+    const char* backend;
+    size_t size;
+    size_t samples;
+    size_t iterations;  // Hashes per sample.
+    double median_ns;
+    double p99_ns;
+    double gbps;
+    double cycles_per_byte;  // Zero when rdtsc is not available.
+};
+
+// Reads the time stamp counter, or returns 0 where there is none.
+inline uint64_t read_cycles() {
+#ifdef SHA_BENCHMARK_HAVE_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
 }
 
-int main() {
-    // Define example input data for hashing
-    const char* data = "The quick brown fox jumps over the lazy dog";
-
-    // Instantiate SHA classes for different hash algorithms
-    sha::SHA256 sha256;
-    sha::SHA224 sha224;
-    sha::SHA512 sha512;
-    sha::SHA384 sha384;
-    sha::SHA512_224 sha512_224;
-    sha::SHA512_256 sha512_256;
-
-    // Benchmark SHA-256
-    std::cout << "Benchmarking SHA-256..." << std::endl;
-    BENCHMARK(
-        std::string result = sha256.hash(data);
-        std::cout << "SHA-256: " << result << std::endl;
-    );
-
-    // Benchmark SHA-224
-    std::cout << "Benchmarking SHA-224..." << std::endl;
-    BENCHMARK(
-        std::string result = sha224.hash(data);
-        std::cout << "SHA-224: " << result << std::endl;
-    );
-
-    // Benchmark SHA-512
-    std::cout << "Benchmarking SHA-512..." << std::endl;
-    BENCHMARK(
-        std::string result = sha512.hash(data);
-        std::cout << "SHA-512: " << result << std::endl;
-    );
-
-    // Benchmark SHA-384
-    std::cout << "Benchmarking SHA-384..." << std::endl;
-    BENCHMARK(
-        std::string result = sha384.hash(data);
-        std::cout << "SHA-384: " << result << std::endl;
-    );
-
-    // Benchmark SHA-512/224
-    std::cout << "Benchmarking SHA-512/224..." << std::endl;
-    BENCHMARK(
-        std::string result = sha512_224.hash(data);
-        std::cout << "SHA-512/224: " << result << std::endl;
-    );
-
-    // Benchmark SHA-512/256
-    std::cout << "Benchmarking SHA-512/256..." << std::endl;
-    BENCHMARK(
-        std::string result = sha512_256.hash(data);
-        std::cout << "SHA-512/256: " << result << std::endl;
-    );
+// Keeps the compiler from discarding the digests of the timed loop.
+volatile uint8_t sink;
+
+// Returns the value at quantile `q` of the sorted `values`.
+double quantile(const std::vector<double>& values, double q) {
+    size_t index = (size_t)(q * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+// Times `Hasher().digest` on the first `size` bytes of `data`.
+template <typename Hasher>
+Result measure(const char* algorithm, const char* backend,
+               const std::vector<uint8_t>& data, size_t size,
+               const Options& options) {
+    Hasher hasher;
+    auto run = [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; i++) {
+            sink = sink ^ hasher.digest(data.data(), size)[0];
+        }
+    };
+
+    // Warm up, then pick the iterations per sample so that one sample takes
+    // at least 10 us or a single hash.
+    run(1);
+    size_t iterations = 1;
+    for (;;) {
+        auto start = Clock::now();
+        run(iterations);
+        double elapsed =
+            std::chrono::duration<double>(Clock::now() - start).count();
+        if (elapsed >= 10e-6 || iterations >= (size_t(1) << 24)) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    std::vector<double> nanoseconds;
+    std::vector<double> cycles;
+    auto deadline =
+        Clock::now() + std::chrono::duration<double>(options.budget);
+    while (nanoseconds.size() < 5 ||
+           (Clock::now() < deadline && nanoseconds.size() < 100000)) {
+        uint64_t start_cycles = read_cycles();
+        auto start = Clock::now();
+        run(iterations);
+        auto end = Clock::now();
+        uint64_t end_cycles = read_cycles();
+        nanoseconds.push_back(
+            std::chrono::duration<double, std::nano>(end - start).count() /
+            iterations);
+        cycles.push_back((double)(end_cycles - start_cycles) / iterations);
+    }
+    std::sort(nanoseconds.begin(), nanoseconds.end());
+    std::sort(cycles.begin(), cycles.end());
+
+    Result result;
+    result.algorithm = algorithm;
+    result.backend = backend;
+    result.size = size;
+    result.samples = nanoseconds.size();
+    result.iterations = iterations;
+    result.median_ns = quantile(nanoseconds, 0.5);
+    result.p99_ns = quantile(nanoseconds, 0.99);
+    result.gbps = size / result.median_ns;
+    result.cycles_per_byte = size == 0 ? 0 : quantile(cycles, 0.5) / size;
+    return result;
+}
+
+// Runs the size sweep for `Hasher` with each backend of its family and
+// restores the default backend afterwards.
+template <typename Hasher>
+void run_algorithm(const char* algorithm, const std::vector<uint8_t>& data,
+                   const Options& options, std::vector<Result>& results,
+                   void (*report)(const Result&)) {
+    const std::string original = Hasher::backend().name;
+    size_t count;
+    const auto* backends = Hasher::backends(&count);
+    for (size_t b = 0; b < count; b++) {
+        if (!options.all_backends && original != backends[b].name) {
+            continue;
+        }
+        if (!Hasher::set_backend(backends[b].name)) {
+            continue;
+        }
+        for (size_t size = options.min_size; size <= options.max_size;
+             size *= 4) {
+            results.push_back(measure<Hasher>(algorithm, backends[b].name,
+                                              data, size, options));
+            report(results.back());
+            if (size == 0) {
+                break;
+            }
+        }
+    }
+    Hasher::set_backend(original.c_str());
+}
+
+// Prints a line of the human-readable table as soon as it is measured.
+void report_table(const Result& r) {
+    std::printf("%-12s %-10s %12zu %12.1f %12.1f %9.3f %9.2f\n", r.algorithm,
+                r.backend, r.size, r.median_ns, r.p99_ns, r.gbps,
+                r.cycles_per_byte);
+    std::fflush(stdout);
+}
+
+void report_none(const Result&) {}
+
+void print_csv(const std::vector<Result>& results) {
+    std::printf("algorithm,backend,size,samples,iterations,median_ns,p99_ns,"
+                "gbps,cycles_per_byte\n");
+    for (const Result& r : results) {
+        std::printf("%s,%s,%zu,%zu,%zu,%.2f,%.2f,%.4f,%.3f\n", r.algorithm,
+                    r.backend, r.size, r.samples, r.iterations, r.median_ns,
+                    r.p99_ns, r.gbps, r.cycles_per_byte);
+    }
+}
+
+void print_json(const std::vector<Result>& results) {
+    std::printf("[\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        std::printf("  {\"algorithm\": \"%s\", \"backend\": \"%s\", "
+                    "\"size\": %zu, \"samples\": %zu, \"iterations\": %zu, "
+                    "\"median_ns\": %.2f, \"p99_ns\": %.2f, \"gbps\": %.4f, "
+                    "\"cycles_per_byte\": %.3f}%s\n",
+                    r.algorithm, r.backend, r.size, r.samples, r.iterations,
+                    r.median_ns, r.p99_ns, r.gbps, r.cycles_per_byte,
+                    i + 1 < results.size() ? "," : "");
+    }
+    std::printf("]\n");
+}
+
+// Parses a size with an optional K, M or G suffix (powers of 1024).
+size_t parse_size(const char* text) {
+    char* end;
+    size_t size = std::strtoull(text, &end, 10);
+    switch (*end) {
+        case 'K': case 'k': return size << 10;
+        case 'M': case 'm': return size << 20;
+        case 'G': case 'g': return size << 30;
+    }
+    return size;
+}
+
+void usage() {
+    std::cout
+        << "Usage: sha_benchmark [options]\n"
+        << "  --format=table|csv|json  Output format (default table)\n"
+        << "  --min-size=N             Smallest message, e.g. 64 (default 16)\n"
+        << "  --max-size=N             Largest message, e.g. 16M (default 1G)\n"
+        << "  --budget=SECONDS         Sampling time per size (default 0.2)\n"
+        << "  --algorithms=LIST        e.g. sha256,sha512 (default all)\n"
+        << "  --default-backend        Only measure the default backends\n"
+        << "Sizes grow by a factor of 4 from --min-size.\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value = arg.substr(arg.find('=') + 1);
+        if (arg.compare(0, 9, "--format=") == 0) {
+            options.format = value;
+        } else if (arg.compare(0, 11, "--min-size=") == 0) {
+            options.min_size = parse_size(value.c_str());
+        } else if (arg.compare(0, 11, "--max-size=") == 0) {
+            options.max_size = parse_size(value.c_str());
+        } else if (arg.compare(0, 9, "--budget=") == 0) {
+            options.budget = std::atof(value.c_str());
+        } else if (arg.compare(0, 13, "--algorithms=") == 0) {
+            options.algorithms = value;
+        } else if (arg == "--default-backend") {
+            options.all_backends = false;
+        } else {
+            usage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    if (options.format != "table" && options.format != "csv" &&
+        options.format != "json") {
+        usage();
+        return 1;
+    }
+
+    // One buffer of the largest size, filled with non-zero data and touched
+    // before any measurement.
+    std::vector<uint8_t> data(options.max_size);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (uint8_t)(i * 131 + 7);
+    }
+
+    auto selected = [&](const char* name) {
+        return options.algorithms == "all" ||
+               ("," + options.algorithms + ",").find(
+                   "," + std::string(name) + ",") != std::string::npos;
+    };
+    void (*report)(const Result&) =
+        options.format == "table" ? report_table : report_none;
+    if (options.format == "table") {
+        std::printf("%-12s %-10s %12s %12s %12s %9s %9s\n", "algorithm",
+                    "backend", "bytes", "median ns", "p99 ns", "GB/s",
+                    "cyc/byte");
+    }
+
+    std::vector<Result> results;
+    if (selected("sha256")) {
+        run_algorithm<sha::SHA256>("SHA-256", data, options, results, report);
+    }
+    if (selected("sha224")) {
+        run_algorithm<sha::SHA224>("SHA-224", data, options, results, report);
+    }
+    if (selected("sha512")) {
+        run_algorithm<sha::SHA512>("SHA-512", data, options, results, report);
+    }
+    if (selected("sha384")) {
+        run_algorithm<sha::SHA384>("SHA-384", data, options, results, report);
+    }
+    if (selected("sha512_224")) {
+        run_algorithm<sha::SHA512_224>("SHA-512/224", data, options, results,
+                                       report);
+    }
+    if (selected("sha512_256")) {
+        run_algorithm<sha::SHA512_256>("SHA-512/256", data, options, results,
+                                       report);
+    }
 
+    if (options.format == "csv") {
+        print_csv(results);
+    } else if (options.format == "json") {
+        print_json(results);
+    }
     return 0;
 }
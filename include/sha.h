@@ -6,6 +6,8 @@
  *
  * - SHABase: A base class containing common methods and utilities used by SHA
  * algorithms.
+ * - SHA2<Traits>: The hashing engine shared by all algorithms below, which are
+ * typedefs of it for their traits.
  * - SHA256: Implements the SHA-256 hashing function.
  * - SHA224: Implements the SHA-224 hashing function, which is a truncated
  * version of SHA-256.
@@ -17,7 +19,7 @@
  *
  * The file provides functionality to compute cryptographic hash values for
  * given input data. Each class supports hashing with optional initial hash
- * values and provides methods to format and convert the output into a
+ * values and returns either the raw digest as a fixed-size byte array or its
  * hexadecimal string representation.
  *
  * This file includes necessary constants, utility functions, and detailed
@@ -28,13 +30,124 @@
 #define SHA_H_
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
 #include <cstdint>
 #include <cstring>
-#include <iomanip>
 #include <memory>
+#include <new>
 #include <string>
 #include <vector>
-#include <sstream>
+
+// Hardware-accelerated compression backends are compiled in with GCC/Clang
+// target attributes and selected at runtime, so the header still builds with
+// the default -march. Define SHA_DISABLE_ACCELERATION to build only the
+// portable implementation.
+#if !defined(SHA_DISABLE_ACCELERATION) && \
+    (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHA_HAVE_X86_KERNELS 1
+#endif
+
+#if !defined(SHA_DISABLE_ACCELERATION) && defined(__aarch64__) && \
+    defined(__linux__) && defined(__GNUC__)
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#define SHA_HAVE_ARM_KERNELS 1
+#endif
+
+// Define SHA_USE_LIBRARY to link against libsha (`make lib`) instead of
+// compiling the accelerated kernels and the backend tables into every
+// translation unit: they are then only declared here. The library compiles
+// each kernel family in its own translation unit of src/ with the -m flags of
+// its instruction set, which defines the matching SHA_BUILD_* macro below.
+#ifdef SHA_USE_LIBRARY
+#define SHA_LIBRARY_INLINE
+#else
+#define SHA_LIBRARY_INLINE inline
+#endif
+#if !defined(SHA_USE_LIBRARY) || defined(SHA_BUILD_X86_SHA)
+#define SHA_DEFINE_X86_SHA 1
+#endif
+#if !defined(SHA_USE_LIBRARY) || defined(SHA_BUILD_X86_AVX2)
+#define SHA_DEFINE_X86_AVX2 1
+#endif
+#if !defined(SHA_USE_LIBRARY) || defined(SHA_BUILD_X86_AVX512)
+#define SHA_DEFINE_X86_AVX512 1
+#endif
+#if !defined(SHA_USE_LIBRARY) || defined(SHA_BUILD_ARM_SHA2)
+#define SHA_DEFINE_ARM_SHA2 1
+#endif
+#if !defined(SHA_USE_LIBRARY) || defined(SHA_BUILD_ARM_SHA512)
+#define SHA_DEFINE_ARM_SHA512 1
+#endif
+#if !defined(SHA_USE_LIBRARY) || defined(SHA_BUILD_DISPATCH)
+#define SHA_DEFINE_DISPATCH 1
+#endif
+
+// Forces inlining of the helpers that the unrolled round loops expand. The
+// helpers that the kernel units of libsha share with the rest of the library
+// are forced inline too, so that no out-of-line copy compiled with a unit's
+// -m flags, e.g. at -O0, can be the one the linker keeps.
+#if defined(__GNUC__)
+#define SHA_ALWAYS_INLINE __attribute__((always_inline)) inline
+#else
+#define SHA_ALWAYS_INLINE inline
+#endif
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#define SHA_HAS_STRING_VIEW 1
+#endif
+
+// Define SHA_ENABLE_STATS to count the bytes, blocks, messages and per-phase
+// cycles of every hash on thread-local counters, read with sha_stats.h.
+// Without it, the SHA_STATS_* hooks expand to nothing.
+#ifdef SHA_ENABLE_STATS
+#include <chrono>
+#include <mutex>
+#define SHA_STATS_ALGORITHM(algorithm) \
+  ::sha::detail::StatsScope sha_stats_scope(algorithm)
+#define SHA_STATS_PHASE(phase) \
+  ::sha::detail::PhaseTimer sha_stats_timer(::sha::detail::STATS_##phase)
+#define SHA_STATS_BYTES(count) \
+  ::sha::detail::stats_add(::sha::detail::STATS_BYTES, count)
+#define SHA_STATS_BLOCKS(count) \
+  ::sha::detail::stats_add(::sha::detail::STATS_BLOCKS, count)
+#define SHA_STATS_MESSAGE(size) ::sha::detail::stats_message(size)
+#else
+#define SHA_STATS_ALGORITHM(algorithm)
+#define SHA_STATS_PHASE(phase)
+#define SHA_STATS_BYTES(count)
+#define SHA_STATS_BLOCKS(count)
+#define SHA_STATS_MESSAGE(size)
+#endif
+
+// Lets the constexpr std::string_view overloads switch to the accelerated
+// backends when they are evaluated at runtime.
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define SHA_HAS_IS_CONSTANT_EVALUATED 1
+#endif
+#elif defined(__GNUC__) && __GNUC__ >= 9
+#define SHA_HAS_IS_CONSTANT_EVALUATED 1
+#endif
+
+// POSIX scatter/gather arrays (struct iovec) are accepted as segmented
+// input where the system declares them.
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/uio.h>
+#define SHA_HAS_IOVEC 1
+#endif
+
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<span>)
+#include <span>
+#define SHA_HAS_SPAN 1
+#endif
+#endif
 
 namespace sha {
 
@@ -103,74 +216,1340 @@ static constexpr uint64_t SHA512_K[] = {
     0x431d67c49c100d4c, 0x4cc5d4becb3e42b6, 0x597f299cfc657e2a,
     0x5fcb6fab3ad6faec, 0x6c44198c4a475817};
 
-class SHABase {
- protected:
-  // Converts a number to a bit string representation.
-  template <typename Type>
-  std::string to_bit_string(Type number) const {
-    std::string bit_string;
-    bit_string.reserve(sizeof(number));
-    for (int i = 7; i >= 0; i--) {
-      bit_string.push_back(number >> i * 8);
+// A block compression backend. `compress` processes `count` consecutive
+// blocks starting at `blocks` and updates the eight hash values in place;
+// `supported` reports whether the running CPU can execute it.
+// `compress_scheduled`, if not null, processes one block whose message
+// schedule is already expanded: `wk[i]` is word i of the schedule plus round
+// constant i. It lets padding blocks known in advance skip the expansion;
+// hardware backends, which expand the schedule themselves, leave it null.
+template <typename Type>
+struct CompressBackend {
+  const char* name;
+  void (*compress)(Type* hash_values, const uint8_t* blocks, size_t count);
+  bool (*supported)();
+  void (*compress_scheduled)(Type* hash_values, const Type* wk);
+};
+
+// A multi-buffer compression backend. `compress` processes one block for each
+// of `lanes` independent messages: `blocks[lane]` points to the lane's block
+// and `state` holds the hash values of all lanes word-major, i.e. word i of
+// lane j is stored at state[i * lanes + j]. A backend with `lanes == 1` has no
+// kernel of its own and hashes messages one at a time with the active
+// CompressBackend. `compress_scheduled` processes one block of every lane
+// from the expanded schedule `wk` that all lanes share, e.g. a common padding
+// block; it is null for the serial fallback.
+template <typename Type>
+struct MultiBufferBackend {
+  const char* name;
+  size_t lanes;
+  void (*compress)(Type* state, const uint8_t* const* blocks);
+  bool (*supported)();
+  void (*compress_scheduled)(Type* state, const Type* wk);
+};
+
+// A read-only view of `size` bytes at `data`.
+struct Segment {
+  const void* data;
+  size_t size;
+};
+
+namespace detail {
+
+// Word size dependent parameters shared by the generic round implementations.
+template <typename Word>
+struct WordTraits;
+
+template <>
+struct WordTraits<uint32_t> {
+  static constexpr size_t BLOCK_SIZE = 64;
+  static constexpr int ROUNDS = 64;
+  static constexpr int BIG_SIGMA_0_A = 2, BIG_SIGMA_0_B = 13,
+                       BIG_SIGMA_0_C = 22;
+  static constexpr int BIG_SIGMA_1_A = 6, BIG_SIGMA_1_B = 11,
+                       BIG_SIGMA_1_C = 25;
+  static constexpr int SMALL_SIGMA_0_A = 7, SMALL_SIGMA_0_B = 18,
+                       SMALL_SIGMA_0_SHIFT = 3;
+  static constexpr int SMALL_SIGMA_1_A = 17, SMALL_SIGMA_1_B = 19,
+                       SMALL_SIGMA_1_SHIFT = 10;
+  SHA_ALWAYS_INLINE static constexpr const uint32_t* k() {
+    return SHA256_K;
+  }
+};
+
+template <>
+struct WordTraits<uint64_t> {
+  static constexpr size_t BLOCK_SIZE = 128;
+  static constexpr int ROUNDS = 80;
+  static constexpr int BIG_SIGMA_0_A = 28, BIG_SIGMA_0_B = 34,
+                       BIG_SIGMA_0_C = 39;
+  static constexpr int BIG_SIGMA_1_A = 14, BIG_SIGMA_1_B = 18,
+                       BIG_SIGMA_1_C = 41;
+  static constexpr int SMALL_SIGMA_0_A = 1, SMALL_SIGMA_0_B = 8,
+                       SMALL_SIGMA_0_SHIFT = 7;
+  static constexpr int SMALL_SIGMA_1_A = 19, SMALL_SIGMA_1_B = 61,
+                       SMALL_SIGMA_1_SHIFT = 6;
+  SHA_ALWAYS_INLINE static constexpr const uint64_t* k() {
+    return SHA512_K;
+  }
+};
+
+// Adapters that let the batch and segmented APIs accept Segment, std::string,
+// std::string_view, std::span and struct iovec inputs.
+inline Segment as_segment(const Segment& input) { return input; }
+inline Segment as_segment(const std::string& input) {
+  return Segment{input.data(), input.size()};
+}
+#ifdef SHA_HAS_STRING_VIEW
+inline Segment as_segment(std::string_view input) {
+  return Segment{input.data(), input.size()};
+}
+#endif
+#ifdef SHA_HAS_SPAN
+inline Segment as_segment(std::span<const uint8_t> input) {
+  return Segment{input.data(), input.size()};
+}
+#endif
+#ifdef SHA_HAS_IOVEC
+inline Segment as_segment(const struct iovec& input) {
+  return Segment{input.iov_base, input.iov_len};
+}
+#endif
+
+// Loads a big-endian word from the bytes at `data`. The shifts are written out
+// so that compilers turn them into a single load and byte swap.
+template <typename Word>
+SHA_ALWAYS_INLINE Word load_word(const uint8_t* data);
+
+template <>
+SHA_ALWAYS_INLINE uint32_t load_word<uint32_t>(const uint8_t* data) {
+  return (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 |
+         (uint32_t)data[2] << 8 | (uint32_t)data[3];
+}
+
+template <>
+SHA_ALWAYS_INLINE uint64_t load_word<uint64_t>(const uint8_t* data) {
+  return (uint64_t)load_word<uint32_t>(data) << 32 |
+         load_word<uint32_t>(data + 4);
+}
+
+// An unrolled compression function shared by both word sizes through
+// WordTraits. Every round is expanded at compile time, so instead of moving
+// the eight working variables at the end of a round, round I addresses them at
+// rotated positions of `v`: variable a lives in v[(0 - I) & 7], b in
+// v[(1 - I) & 7] and so on. The message schedule is kept in a rolling window
+// of 16 words that is extended one word per round, interleaved with the
+// rounds that consume it. With all indices constant, the compiler keeps both
+// arrays in registers.
+template <typename Word>
+struct Unrolled {
+  typedef WordTraits<Word> Traits;
+
+  SHA_ALWAYS_INLINE static constexpr Word rotr(Word x, int n) {
+    return (x >> n) | (x << (8 * sizeof(Word) - n));
+  }
+
+  // Updates the working variables for round I, given the sum `wk` of the
+  // round's schedule word and constant.
+  template <int I>
+  SHA_ALWAYS_INLINE static void step(Word* v, Word wk) {
+    Word& a = v[(0 - I) & 7];
+    Word& b = v[(1 - I) & 7];
+    Word& c = v[(2 - I) & 7];
+    Word& d = v[(3 - I) & 7];
+    Word& e = v[(4 - I) & 7];
+    Word& f = v[(5 - I) & 7];
+    Word& g = v[(6 - I) & 7];
+    Word& h = v[(7 - I) & 7];
+    const Word t1 = h +
+                    (rotr(e, Traits::BIG_SIGMA_1_A) ^
+                     rotr(e, Traits::BIG_SIGMA_1_B) ^
+                     rotr(e, Traits::BIG_SIGMA_1_C)) +
+                    ((e & f) ^ (~e & g)) + wk;
+    const Word t2 = (rotr(a, Traits::BIG_SIGMA_0_A) ^
+                     rotr(a, Traits::BIG_SIGMA_0_B) ^
+                     rotr(a, Traits::BIG_SIGMA_0_C)) +
+                    ((a & b) ^ (a & c) ^ (b & c));
+    d += t1;
+    h = t1 + t2;
+  }
+
+  template <int I>
+  SHA_ALWAYS_INLINE static void round(Word* v, Word* w,
+                                      const uint8_t* block) {
+    Word word;
+    if (I < 16) {
+      word = w[I & 15] = load_word<Word>(block + (I & 15) * sizeof(Word));
+    } else {
+      const Word w15 = w[(I - 15) & 15];
+      const Word w2 = w[(I - 2) & 15];
+      word = w[I & 15] +=
+          (rotr(w15, Traits::SMALL_SIGMA_0_A) ^
+           rotr(w15, Traits::SMALL_SIGMA_0_B) ^
+           (w15 >> Traits::SMALL_SIGMA_0_SHIFT)) +
+          w[(I - 7) & 15] +
+          (rotr(w2, Traits::SMALL_SIGMA_1_A) ^
+           rotr(w2, Traits::SMALL_SIGMA_1_B) ^
+           (w2 >> Traits::SMALL_SIGMA_1_SHIFT));
     }
-    return bit_string;
+    step<I>(v, Traits::k()[I] + word);
   }
 
-  // Converts a character array to an integral type representation.
-  template <typename Type>
-  Type to_integral(const char* data) const {
-    Type value = 0;
-    for (int i = 0; i < sizeof(Type); i++) {
-      value |= (Type)(uint8_t)data[sizeof(Type) - 1 - i] << i * 8;
+  // Expands rounds [I, End) in order.
+  template <int I, int End>
+  struct Rounds {
+    SHA_ALWAYS_INLINE static void run(Word* v, Word* w,
+                                      const uint8_t* block) {
+      round<I>(v, w, block);
+      Rounds<I + 1, End>::run(v, w, block);
+    }
+  };
+  template <int End>
+  struct Rounds<End, End> {
+    SHA_ALWAYS_INLINE static void run(Word*, Word*, const uint8_t*) {}
+  };
+
+  // Compresses `count` consecutive blocks into the eight hash values.
+  static void compress(Word* hash_values, const uint8_t* blocks,
+                       size_t count) {
+    for (; count != 0; count--, blocks += Traits::BLOCK_SIZE) {
+      Word v[8];
+      Word w[16];
+      for (int i = 0; i < 8; i++) {
+        v[i] = hash_values[i];
+      }
+      // A round count divisible by 8 leaves the variables at their home
+      // positions after the last round.
+      static_assert(Traits::ROUNDS % 8 == 0, "rounds must be a multiple of 8");
+      Rounds<0, Traits::ROUNDS>::run(v, w, blocks);
+      for (int i = 0; i < 8; i++) {
+        hash_values[i] += v[i];
+      }
     }
-    return value;
   }
 
-  // Converts a preprocessed string into a vector of integral types.
-  template <typename Type>
-  std::vector<Type> to_integral_vector(
-      const std::string& preprocessed_data) const {
-    std::vector<Type> data_in_integral(preprocessed_data.size() / sizeof(Type));
-    int k = 0;
-    for (int i = 0; i < data_in_integral.size(); i++) {
-      data_in_integral[i] = to_integral<Type>(preprocessed_data.c_str() + k);
-      k += sizeof(Type);
+  // Expands rounds [I, End) of a block whose schedule sums are in `wk`.
+  template <int I, int End>
+  struct ScheduledRounds {
+    SHA_ALWAYS_INLINE static void run(Word* v, const Word* wk) {
+      step<I>(v, wk[I]);
+      ScheduledRounds<I + 1, End>::run(v, wk);
+    }
+  };
+  template <int End>
+  struct ScheduledRounds<End, End> {
+    SHA_ALWAYS_INLINE static void run(Word*, const Word*) {}
+  };
+
+  // Compresses one block given the sums `wk` of its expanded schedule and
+  // the round constants.
+  static void compress_scheduled(Word* hash_values, const Word* wk) {
+    Word v[8];
+    for (int i = 0; i < 8; i++) {
+      v[i] = hash_values[i];
+    }
+    ScheduledRounds<0, Traits::ROUNDS>::run(v, wk);
+    for (int i = 0; i < 8; i++) {
+      hash_values[i] += v[i];
     }
-    return data_in_integral;
   }
 
-  // Converts a string to its hexadecimal representation.
-  std::string to_hex(const std::string& str) const {
-    std::ostringstream oss;
-    for (const char& ch : str) {
-      unsigned int x = (unsigned char)ch;
-      oss << std::hex << std::setw(2) << std::setfill('0') << x;
+  // Reports whether schedule word j of a block whose words [V, 16) are fixed
+  // padding depends on the message.
+  static constexpr bool varies(int j, int V) { return j < V || j >= 16; }
+
+  // Round I of a one-block message of V words whose padding words [V, 16)
+  // are known in advance. `fixed[I]` is the part of schedule word I that
+  // depends on the padding words alone, so they are neither loaded nor put
+  // through the small sigma functions, and only the terms that involve the
+  // message are computed here.
+  template <int I, int V>
+  SHA_ALWAYS_INLINE static void fixed_round(Word* v, Word* w,
+                                            const uint8_t* message,
+                                            const Word* fixed) {
+    Word word;
+    if (I < V) {
+      word = w[I & 15] = load_word<Word>(message + (I & 15) * sizeof(Word));
+    } else if (I < 16) {
+      word = fixed[I];
+    } else {
+      word = fixed[I];
+      if (varies(I - 16, V)) {
+        word += w[(I - 16) & 15];
+      }
+      if (varies(I - 15, V)) {
+        const Word w15 = w[(I - 15) & 15];
+        word += rotr(w15, Traits::SMALL_SIGMA_0_A) ^
+                rotr(w15, Traits::SMALL_SIGMA_0_B) ^
+                (w15 >> Traits::SMALL_SIGMA_0_SHIFT);
+      }
+      if (varies(I - 7, V)) {
+        word += w[(I - 7) & 15];
+      }
+      if (varies(I - 2, V)) {
+        const Word w2 = w[(I - 2) & 15];
+        word += rotr(w2, Traits::SMALL_SIGMA_1_A) ^
+                rotr(w2, Traits::SMALL_SIGMA_1_B) ^
+                (w2 >> Traits::SMALL_SIGMA_1_SHIFT);
+      }
+      w[I & 15] = word;
     }
-    return oss.str();
+    step<I>(v, Traits::k()[I] + word);
   }
 
-  // Converts an array of hash values to a string representation.
-  template <typename Type>
-  std::string to_string(const Type* hash_digest) const {
-    std::string str_repr;
-    str_repr.reserve(sizeof(Type) * 8);
+  // Expands rounds [I, End) of a one-block message of V words.
+  template <int I, int End, int V>
+  struct FixedRounds {
+    SHA_ALWAYS_INLINE static void run(Word* v, Word* w, const uint8_t* message,
+                                      const Word* fixed) {
+      fixed_round<I, V>(v, w, message, fixed);
+      FixedRounds<I + 1, End, V>::run(v, w, message, fixed);
+    }
+  };
+  template <int End, int V>
+  struct FixedRounds<End, End, V> {
+    SHA_ALWAYS_INLINE static void run(Word*, Word*, const uint8_t*,
+                                      const Word*) {}
+  };
+
+  // Compresses the padded block of the V-word message at `message`, given
+  // the schedule parts `fixed` that its padding determines. The message is
+  // read in place and the padding is never written out.
+  template <int V>
+  static void compress_fixed(Word* hash_values, const uint8_t* message,
+                             const Word* fixed) {
+    static_assert(V < 16, "the padding must fill at least one word");
+    Word v[8];
+    Word w[16];
     for (int i = 0; i < 8; i++) {
-      for (int j = sizeof(Type) - 1; j >= 0; j--) {
-        str_repr.push_back(hash_digest[i] >> j * 8);
+      v[i] = hash_values[i];
+    }
+    FixedRounds<0, Traits::ROUNDS, V>::run(v, w, message, fixed);
+    for (int i = 0; i < 8; i++) {
+      hash_values[i] += v[i];
+    }
+  }
+};
+
+#ifdef SHA_HAVE_X86_KERNELS
+// Reports whether the CPU implements the SHA extensions together with the
+// SSSE3 and SSE4.1 instructions used alongside them.
+inline bool cpu_has_sha_ni() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSSE3) ||
+      !(ecx & bit_SSE4_1)) {
+    return false;
+  }
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  return (ebx & (1u << 29)) != 0;
+}
+
+// SHA-256 compression using the x86 SHA extensions. The state is kept in the
+// ABEF/CDGH register layout expected by sha256rnds2, and each iteration of
+// the inner loop performs four rounds while sha256msg1/sha256msg2 expand the
+// message schedule four words at a time.
+#ifdef SHA_DEFINE_X86_SHA
+__attribute__((target("sha,ssse3,sse4.1"))) SHA_LIBRARY_INLINE void
+sha256_compress_shani(uint32_t* hash_values, const uint8_t* blocks,
+                      size_t count) {
+  const __m128i byte_swap =
+      _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+  __m128i tmp = _mm_loadu_si128((const __m128i*)&hash_values[0]);
+  __m128i state1 = _mm_loadu_si128((const __m128i*)&hash_values[4]);
+  tmp = _mm_shuffle_epi32(tmp, 0xb1);                // CDAB
+  state1 = _mm_shuffle_epi32(state1, 0x1b);          // EFGH
+  __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);  // ABEF
+  state1 = _mm_blend_epi16(state1, tmp, 0xf0);       // CDGH
+
+  for (; count != 0; count--, blocks += 64) {
+    const __m128i abef_save = state0;
+    const __m128i cdgh_save = state1;
+    __m128i words[4];
+
+#pragma GCC unroll 16
+    for (int group = 0; group < 16; group++) {
+      __m128i& current = words[group & 3];
+      if (group < 4) {
+        current = _mm_shuffle_epi8(
+            _mm_loadu_si128((const __m128i*)(blocks + group * 16)), byte_swap);
+      }
+      __m128i msg = _mm_add_epi32(
+          current, _mm_loadu_si128((const __m128i*)&SHA256_K[group * 4]));
+      state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+      if (group >= 3 && group < 15) {
+        __m128i& next = words[(group + 1) & 3];
+        next = _mm_add_epi32(
+            next, _mm_alignr_epi8(current, words[(group + 3) & 3], 4));
+        next = _mm_sha256msg2_epu32(next, current);
+      }
+      msg = _mm_shuffle_epi32(msg, 0x0e);
+      state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+      if (group >= 1 && group < 13) {
+        __m128i& previous = words[(group + 3) & 3];
+        previous = _mm_sha256msg1_epu32(previous, current);
+      }
+    }
+
+    state0 = _mm_add_epi32(state0, abef_save);
+    state1 = _mm_add_epi32(state1, cdgh_save);
+  }
+
+  tmp = _mm_shuffle_epi32(state0, 0x1b);        // FEBA
+  state1 = _mm_shuffle_epi32(state1, 0xb1);     // DCHG
+  state0 = _mm_blend_epi16(tmp, state1, 0xf0);  // DCBA
+  state1 = _mm_alignr_epi8(state1, tmp, 8);     // ABEF
+  _mm_storeu_si128((__m128i*)&hash_values[0], state0);
+  _mm_storeu_si128((__m128i*)&hash_values[4], state1);
+}
+#else
+void sha256_compress_shani(uint32_t* hash_values, const uint8_t* blocks,
+                           size_t count);
+#endif
+
+// Generic multi-buffer round function written with GCC vector extensions.
+// Each vector holds the same word of `Lanes` independent messages, so one
+// pass over the rounds compresses a block of every lane. The function is
+// always inlined into the target-specific wrappers below, which lets the
+// compiler lower the vector operations to the instruction set of the caller.
+template <typename Word, size_t Lanes>
+struct MultiBuffer {
+  typedef WordTraits<Word> Traits;
+  typedef Word Vector __attribute__((vector_size(sizeof(Word) * Lanes)));
+
+  __attribute__((always_inline)) static inline void compress(
+      Word* state, const uint8_t* const* blocks) {
+    Word transposed[16][Lanes];
+    for (size_t lane = 0; lane < Lanes; lane++) {
+      for (int i = 0; i < 16; i++) {
+        transposed[i][lane] = load_word<Word>(blocks[lane] + i * sizeof(Word));
+      }
+    }
+    Vector words[16];
+    std::memcpy(words, transposed, sizeof(words));
+    rounds<false>(state, words, nullptr);
+  }
+
+  // Compresses one block of every lane from the schedule sums `wk` that the
+  // lanes share.
+  __attribute__((always_inline)) static inline void compress_scheduled(
+      Word* state, const Word* wk) {
+    rounds<true>(state, nullptr, wk);
+  }
+
+  // Runs the rounds of one block on the lanes of `state`, expanding the
+  // schedule from `words` or, if `Scheduled`, reading it from `wk`.
+  template <bool Scheduled>
+  __attribute__((always_inline)) static inline void rounds(
+      Word* state, Vector* words, const Word* wk) {
+#define SHA_MB_ROTR(x, n) (((x) >> (n)) | ((x) << (sizeof(Word) * 8 - (n))))
+    Vector v[8];
+    std::memcpy(v, state, sizeof(v));
+    Vector a = v[0], b = v[1], c = v[2], d = v[3];
+    Vector e = v[4], f = v[5], g = v[6], h = v[7];
+
+    for (int round = 0; round < Traits::ROUNDS; round += 16) {
+#pragma GCC unroll 16
+      for (int j = 0; j < 16; j++) {
+        const int i = round + j;
+        Vector sum;
+        if (Scheduled) {
+          sum = Vector{} + wk[i];
+        } else {
+          Vector& w = words[j];
+          if (i >= 16) {
+            const Vector w2 = words[(j - 2) & 15];
+            const Vector w15 = words[(j - 15) & 15];
+            w += (SHA_MB_ROTR(w2, Traits::SMALL_SIGMA_1_A) ^
+                  SHA_MB_ROTR(w2, Traits::SMALL_SIGMA_1_B) ^
+                  (w2 >> Traits::SMALL_SIGMA_1_SHIFT)) +
+                 words[(j - 7) & 15] +
+                 (SHA_MB_ROTR(w15, Traits::SMALL_SIGMA_0_A) ^
+                  SHA_MB_ROTR(w15, Traits::SMALL_SIGMA_0_B) ^
+                  (w15 >> Traits::SMALL_SIGMA_0_SHIFT));
+          }
+          sum = w + Traits::k()[i];
+        }
+        const Vector T1 = h +
+                          (SHA_MB_ROTR(e, Traits::BIG_SIGMA_1_A) ^
+                           SHA_MB_ROTR(e, Traits::BIG_SIGMA_1_B) ^
+                           SHA_MB_ROTR(e, Traits::BIG_SIGMA_1_C)) +
+                          ((e & f) ^ (~e & g)) + sum;
+        const Vector T2 = (SHA_MB_ROTR(a, Traits::BIG_SIGMA_0_A) ^
+                           SHA_MB_ROTR(a, Traits::BIG_SIGMA_0_B) ^
+                           SHA_MB_ROTR(a, Traits::BIG_SIGMA_0_C)) +
+                          ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + T1;
+        d = c;
+        c = b;
+        b = a;
+        a = T1 + T2;
+      }
+    }
+
+    v[0] += a;
+    v[1] += b;
+    v[2] += c;
+    v[3] += d;
+    v[4] += e;
+    v[5] += f;
+    v[6] += g;
+    v[7] += h;
+    std::memcpy(state, v, sizeof(v));
+#undef SHA_MB_ROTR
+  }
+};
+
+// Reports whether the CPU and operating system support AVX2.
+inline bool cpu_has_avx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+// Reports whether the CPU and operating system support AVX-512F.
+inline bool cpu_has_avx512f() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx512f");
+}
+
+// Eight-lane SHA-256 compression with AVX2, from blocks or from a
+// shared schedule.
+#ifdef SHA_DEFINE_X86_AVX2
+__attribute__((target("avx2"))) SHA_LIBRARY_INLINE void
+sha256_compress_x8_avx2(uint32_t* state, const uint8_t* const* blocks) {
+  MultiBuffer<uint32_t, 8>::compress(state, blocks);
+}
+__attribute__((target("avx2"))) SHA_LIBRARY_INLINE void
+sha256_compress_x8_avx2_scheduled(uint32_t* state, const uint32_t* wk) {
+  MultiBuffer<uint32_t, 8>::compress_scheduled(state, wk);
+}
+#else
+void sha256_compress_x8_avx2(uint32_t* state, const uint8_t* const* blocks);
+void sha256_compress_x8_avx2_scheduled(uint32_t* state, const uint32_t* wk);
+#endif
+
+// Sixteen-lane SHA-256 compression with AVX-512F, from blocks or from a
+// shared schedule.
+#ifdef SHA_DEFINE_X86_AVX512
+__attribute__((target("avx512f"))) SHA_LIBRARY_INLINE void
+sha256_compress_x16_avx512(uint32_t* state, const uint8_t* const* blocks) {
+  MultiBuffer<uint32_t, 16>::compress(state, blocks);
+}
+__attribute__((target("avx512f"))) SHA_LIBRARY_INLINE void
+sha256_compress_x16_avx512_scheduled(uint32_t* state, const uint32_t* wk) {
+  MultiBuffer<uint32_t, 16>::compress_scheduled(state, wk);
+}
+#else
+void sha256_compress_x16_avx512(uint32_t* state, const uint8_t* const* blocks);
+void sha256_compress_x16_avx512_scheduled(uint32_t* state,
+                                          const uint32_t* wk);
+#endif
+
+// Four-lane SHA-512 compression with AVX2, from blocks or from a
+// shared schedule.
+#ifdef SHA_DEFINE_X86_AVX2
+__attribute__((target("avx2"))) SHA_LIBRARY_INLINE void
+sha512_compress_x4_avx2(uint64_t* state, const uint8_t* const* blocks) {
+  MultiBuffer<uint64_t, 4>::compress(state, blocks);
+}
+__attribute__((target("avx2"))) SHA_LIBRARY_INLINE void
+sha512_compress_x4_avx2_scheduled(uint64_t* state, const uint64_t* wk) {
+  MultiBuffer<uint64_t, 4>::compress_scheduled(state, wk);
+}
+#else
+void sha512_compress_x4_avx2(uint64_t* state, const uint8_t* const* blocks);
+void sha512_compress_x4_avx2_scheduled(uint64_t* state, const uint64_t* wk);
+#endif
+
+// Eight-lane SHA-512 compression with AVX-512F, from blocks or from a
+// shared schedule.
+#ifdef SHA_DEFINE_X86_AVX512
+__attribute__((target("avx512f"))) SHA_LIBRARY_INLINE void
+sha512_compress_x8_avx512(uint64_t* state, const uint8_t* const* blocks) {
+  MultiBuffer<uint64_t, 8>::compress(state, blocks);
+}
+__attribute__((target("avx512f"))) SHA_LIBRARY_INLINE void
+sha512_compress_x8_avx512_scheduled(uint64_t* state, const uint64_t* wk) {
+  MultiBuffer<uint64_t, 8>::compress_scheduled(state, wk);
+}
+#else
+void sha512_compress_x8_avx512(uint64_t* state, const uint8_t* const* blocks);
+void sha512_compress_x8_avx512_scheduled(uint64_t* state, const uint64_t* wk);
+#endif
+
+// Reports whether the CPU supports AVX2 and the BMI2 rotates (rorx) used by
+// the single-stream SHA-512 kernel.
+inline bool cpu_has_avx2_bmi2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2");
+}
+
+#define SHA_TARGET_AVX2_BMI2 __attribute__((target("avx2,bmi2")))
+
+#ifdef SHA_DEFINE_X86_AVX2
+// Single-stream SHA-512 compression for CPUs without SHA-512 instructions,
+// after Intel's AVX2 implementation. The message schedule is expanded four
+// words at a time in 256-bit registers, which also add the round constants,
+// and the scalar rounds read the sums W + K from a stack buffer. Each group
+// of four rounds expands the four words needed four groups later, so the
+// vector work overlaps the dependency chain of the scalar rounds.
+struct Sha512Avx2 {
+  typedef WordTraits<uint64_t> Traits;
+
+  SHA_TARGET_AVX2_BMI2 SHA_ALWAYS_INLINE static __m256i rotr(__m256i x,
+                                                              int n) {
+    return _mm256_or_si256(_mm256_srli_epi64(x, n),
+                           _mm256_slli_epi64(x, 64 - n));
+  }
+
+  SHA_TARGET_AVX2_BMI2 SHA_ALWAYS_INLINE static __m256i small_sigma_0(
+      __m256i x) {
+    return _mm256_xor_si256(
+        _mm256_xor_si256(rotr(x, Traits::SMALL_SIGMA_0_A),
+                         rotr(x, Traits::SMALL_SIGMA_0_B)),
+        _mm256_srli_epi64(x, Traits::SMALL_SIGMA_0_SHIFT));
+  }
+
+  SHA_TARGET_AVX2_BMI2 SHA_ALWAYS_INLINE static __m256i small_sigma_1(
+      __m256i x) {
+    return _mm256_xor_si256(
+        _mm256_xor_si256(rotr(x, Traits::SMALL_SIGMA_1_A),
+                         rotr(x, Traits::SMALL_SIGMA_1_B)),
+        _mm256_srli_epi64(x, Traits::SMALL_SIGMA_1_SHIFT));
+  }
+
+  // Returns W[t..t+3] from w16 = W[t-16..t-13], w12 = W[t-12..t-9],
+  // w8 = W[t-8..t-5] and w4 = W[t-4..t-1]. W[t] and W[t+1] depend on
+  // W[t-2] and W[t-1]; W[t+2] and W[t+3] depend on the two words just
+  // computed, so sigma_1 is applied in two halves.
+  SHA_TARGET_AVX2_BMI2 SHA_ALWAYS_INLINE static __m256i schedule(
+      __m256i w16, __m256i w12, __m256i w8, __m256i w4) {
+    const __m256i w15 = _mm256_alignr_epi8(
+        _mm256_permute2x128_si256(w16, w12, 0x21), w16, 8);
+    const __m256i w7 = _mm256_alignr_epi8(
+        _mm256_permute2x128_si256(w8, w4, 0x21), w8, 8);
+    const __m256i partial =
+        _mm256_add_epi64(_mm256_add_epi64(w16, w7), small_sigma_0(w15));
+    const __m256i low = _mm256_add_epi64(
+        partial, small_sigma_1(_mm256_permute4x64_epi64(w4, 0xee)));
+    const __m256i high = _mm256_add_epi64(
+        partial, small_sigma_1(_mm256_permute4x64_epi64(low, 0x44)));
+    return _mm256_blend_epi32(low, high, 0xf0);
+  }
+
+  // Round I from the schedule sums in `wk`.
+  template <int I>
+  SHA_TARGET_AVX2_BMI2 SHA_ALWAYS_INLINE static void round(
+      uint64_t* v, const uint64_t* wk) {
+    Unrolled<uint64_t>::step<I>(v, wk[I]);
+  }
+
+  // Expands groups [G, End) of four rounds. The first 16 groups also expand
+  // schedule words 16 + 4G to 19 + 4G into the ring `x`.
+  template <int G, int End>
+  struct Groups {
+    SHA_TARGET_AVX2_BMI2 SHA_ALWAYS_INLINE static void run(uint64_t* v,
+                                                            uint64_t* wk,
+                                                            __m256i* x) {
+      if (G < 16) {
+        const __m256i next = schedule(x[G & 3], x[(G + 1) & 3],
+                                      x[(G + 2) & 3], x[(G + 3) & 3]);
+        x[G & 3] = next;
+        _mm256_store_si256(
+            (__m256i*)&wk[16 + 4 * G],
+            _mm256_add_epi64(next, _mm256_loadu_si256(
+                                       (const __m256i*)&SHA512_K[16 + 4 * G])));
+      }
+      round<4 * G>(v, wk);
+      round<4 * G + 1>(v, wk);
+      round<4 * G + 2>(v, wk);
+      round<4 * G + 3>(v, wk);
+      Groups<G + 1, End>::run(v, wk, x);
+    }
+  };
+  template <int End>
+  struct Groups<End, End> {
+    SHA_TARGET_AVX2_BMI2 SHA_ALWAYS_INLINE static void run(uint64_t*,
+                                                            uint64_t*,
+                                                            __m256i*) {}
+  };
+
+  SHA_TARGET_AVX2_BMI2 static void compress(uint64_t* hash_values,
+                                            const uint8_t* blocks,
+                                            size_t count) {
+    // Reverses the bytes of each 64-bit word.
+    const __m256i byte_swap = _mm256_setr_epi8(
+        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2,
+        1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    alignas(32) uint64_t wk[Traits::ROUNDS];
+    for (; count != 0; count--, blocks += Traits::BLOCK_SIZE) {
+      __m256i x[4];
+      for (int i = 0; i < 4; i++) {
+        x[i] = _mm256_shuffle_epi8(
+            _mm256_loadu_si256((const __m256i*)(blocks + 32 * i)), byte_swap);
+        _mm256_store_si256(
+            (__m256i*)&wk[4 * i],
+            _mm256_add_epi64(
+                x[i], _mm256_loadu_si256((const __m256i*)&SHA512_K[4 * i])));
+      }
+      uint64_t v[8];
+      for (int i = 0; i < 8; i++) {
+        v[i] = hash_values[i];
+      }
+      Groups<0, Traits::ROUNDS / 4>::run(v, wk, x);
+      for (int i = 0; i < 8; i++) {
+        hash_values[i] += v[i];
+      }
+    }
+  }
+};
+
+// The single-stream SHA-512 backend.
+SHA_TARGET_AVX2_BMI2 SHA_LIBRARY_INLINE void sha512_compress_avx2(
+    uint64_t* hash_values, const uint8_t* blocks, size_t count) {
+  Sha512Avx2::compress(hash_values, blocks, count);
+}
+#else
+void sha512_compress_avx2(uint64_t* hash_values, const uint8_t* blocks,
+                          size_t count);
+#endif
+#endif  // SHA_HAVE_X86_KERNELS
+
+#ifdef SHA_HAVE_ARM_KERNELS
+#if defined(__clang__)
+#define SHA_TARGET_ARM_SHA2 __attribute__((target("sha2")))
+#define SHA_TARGET_ARM_SHA512 __attribute__((target("sha3")))
+#else
+#define SHA_TARGET_ARM_SHA2 __attribute__((target("+crypto")))
+#define SHA_TARGET_ARM_SHA512 __attribute__((target("arch=armv8.2-a+sha3")))
+#endif
+
+// Reports whether the kernel advertises the ARMv8 SHA-256 instructions.
+inline bool cpu_has_arm_sha2() {
+  return (getauxval(AT_HWCAP) & (1ul << 6)) != 0;  // HWCAP_SHA2
+}
+
+// Reports whether the kernel advertises the ARMv8.2 SHA-512 instructions.
+inline bool cpu_has_arm_sha512() {
+  return (getauxval(AT_HWCAP) & (1ul << 21)) != 0;  // HWCAP_SHA512
+}
+
+// SHA-256 compression using the ARMv8 Crypto Extensions. Each iteration of the
+// inner loop performs four rounds with sha256h/sha256h2 and, for the first
+// twelve groups, expands the next four schedule words with sha256su0/su1.
+#ifdef SHA_DEFINE_ARM_SHA2
+SHA_TARGET_ARM_SHA2 SHA_LIBRARY_INLINE void sha256_compress_armv8(
+    uint32_t* hash_values, const uint8_t* blocks, size_t count) {
+  uint32x4_t state0 = vld1q_u32(&hash_values[0]);  // ABCD
+  uint32x4_t state1 = vld1q_u32(&hash_values[4]);  // EFGH
+
+  for (; count != 0; count--, blocks += 64) {
+    const uint32x4_t abcd_save = state0;
+    const uint32x4_t efgh_save = state1;
+    uint32x4_t words[4];
+    for (int i = 0; i < 4; i++) {
+      words[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + i * 16)));
+    }
+
+#pragma GCC unroll 16
+    for (int group = 0; group < 16; group++) {
+      uint32x4_t& current = words[group & 3];
+      const uint32x4_t wk = vaddq_u32(current, vld1q_u32(&SHA256_K[group * 4]));
+      if (group < 12) {
+        current = vsha256su1q_u32(
+            vsha256su0q_u32(current, words[(group + 1) & 3]),
+            words[(group + 2) & 3], words[(group + 3) & 3]);
       }
+      const uint32x4_t abcd = state0;
+      state0 = vsha256hq_u32(state0, state1, wk);
+      state1 = vsha256h2q_u32(state1, abcd, wk);
+    }
+
+    state0 = vaddq_u32(state0, abcd_save);
+    state1 = vaddq_u32(state1, efgh_save);
+  }
+
+  vst1q_u32(&hash_values[0], state0);
+  vst1q_u32(&hash_values[4], state1);
+}
+#else
+void sha256_compress_armv8(uint32_t* hash_values, const uint8_t* blocks,
+                           size_t count);
+#endif
+
+// SHA-512 compression using the ARMv8.2 SHA-512 instructions. The state is
+// held as four register pairs (ab, cd, ef, gh) whose roles rotate by one
+// position every two rounds, so no data is moved between round pairs.
+#ifdef SHA_DEFINE_ARM_SHA512
+SHA_TARGET_ARM_SHA512 SHA_LIBRARY_INLINE void sha512_compress_armv8(
+    uint64_t* hash_values, const uint8_t* blocks, size_t count) {
+  uint64x2_t state[4];
+  for (int i = 0; i < 4; i++) {
+    state[i] = vld1q_u64(&hash_values[i * 2]);
+  }
+
+  for (; count != 0; count--, blocks += 128) {
+    uint64x2_t save[4];
+    uint64x2_t words[8];
+    for (int i = 0; i < 4; i++) {
+      save[i] = state[i];
+    }
+    for (int i = 0; i < 8; i++) {
+      words[i] = vreinterpretq_u64_u8(vrev64q_u8(vld1q_u8(blocks + i * 16)));
+    }
+
+#pragma GCC unroll 40
+    for (int pair = 0; pair < 40; pair++) {
+      const int rotation = pair & 3;
+      uint64x2_t& ab = state[(4 - rotation) & 3];
+      uint64x2_t& cd = state[(5 - rotation) & 3];
+      uint64x2_t& ef = state[(6 - rotation) & 3];
+      uint64x2_t& gh = state[(7 - rotation) & 3];
+      uint64x2_t& current = words[pair & 7];
+
+      uint64x2_t wk = vaddq_u64(current, vld1q_u64(&SHA512_K[pair * 2]));
+      wk = vaddq_u64(vextq_u64(wk, wk, 1), gh);
+      const uint64x2_t sum = vsha512hq_u64(wk, vextq_u64(ef, gh, 1),
+                                           vextq_u64(cd, ef, 1));
+      gh = vsha512h2q_u64(sum, cd, ab);
+      cd = vaddq_u64(cd, sum);
+      if (pair < 32) {
+        current = vsha512su1q_u64(
+            vsha512su0q_u64(current, words[(pair + 1) & 7]),
+            words[(pair + 7) & 7],
+            vextq_u64(words[(pair + 4) & 7], words[(pair + 5) & 7], 1));
+      }
+    }
+
+    for (int i = 0; i < 4; i++) {
+      state[i] = vaddq_u64(state[i], save[i]);
+    }
+  }
+
+  for (int i = 0; i < 4; i++) {
+    vst1q_u64(&hash_values[i * 2], state[i]);
+  }
+}
+#else
+void sha512_compress_armv8(uint64_t* hash_values, const uint8_t* blocks,
+                           size_t count);
+#endif
+#endif  // SHA_HAVE_ARM_KERNELS
+
+#ifdef SHA_HAS_STRING_VIEW
+// A SHA-2 implementation that can run during constant evaluation. It backs
+// the constexpr std::string_view digest overloads and is written with plain
+// loops over local arrays, which C++17 allows in constexpr functions.
+template <typename Word>
+constexpr Word constexpr_rotr(Word x, int n) {
+  return (x >> n) | (x << (8 * sizeof(Word) - n));
+}
+
+template <typename Word>
+constexpr void constexpr_compress(Word* hash_values, const uint8_t* block) {
+  typedef WordTraits<Word> Traits;
+  Word words[Traits::ROUNDS] = {};
+  for (size_t i = 0; i < 16; i++) {
+    for (size_t b = 0; b < sizeof(Word); b++) {
+      words[i] = (words[i] << 8) | block[i * sizeof(Word) + b];
+    }
+  }
+  for (int i = 16; i < Traits::ROUNDS; i++) {
+    Word s0 = constexpr_rotr(words[i - 15], Traits::SMALL_SIGMA_0_A) ^
+              constexpr_rotr(words[i - 15], Traits::SMALL_SIGMA_0_B) ^
+              (words[i - 15] >> Traits::SMALL_SIGMA_0_SHIFT);
+    Word s1 = constexpr_rotr(words[i - 2], Traits::SMALL_SIGMA_1_A) ^
+              constexpr_rotr(words[i - 2], Traits::SMALL_SIGMA_1_B) ^
+              (words[i - 2] >> Traits::SMALL_SIGMA_1_SHIFT);
+    words[i] = words[i - 16] + s0 + words[i - 7] + s1;
+  }
+
+  Word v[8] = {};
+  for (int i = 0; i < 8; i++) {
+    v[i] = hash_values[i];
+  }
+  for (int i = 0; i < Traits::ROUNDS; i++) {
+    Word s1 = constexpr_rotr(v[4], Traits::BIG_SIGMA_1_A) ^
+              constexpr_rotr(v[4], Traits::BIG_SIGMA_1_B) ^
+              constexpr_rotr(v[4], Traits::BIG_SIGMA_1_C);
+    Word ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+    Word temp1 = v[7] + s1 + ch + Traits::k()[i] + words[i];
+    Word s0 = constexpr_rotr(v[0], Traits::BIG_SIGMA_0_A) ^
+              constexpr_rotr(v[0], Traits::BIG_SIGMA_0_B) ^
+              constexpr_rotr(v[0], Traits::BIG_SIGMA_0_C);
+    Word maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+    for (int j = 7; j > 0; j--) {
+      v[j] = v[j - 1];
+    }
+    v[4] += temp1;
+    v[0] = temp1 + s0 + maj;
+  }
+  for (int i = 0; i < 8; i++) {
+    hash_values[i] += v[i];
+  }
+}
+
+// Returns the leading N bytes of the digest of `data` for the SHA-2 variant
+// with word type Word and initial hash values `init_hash`.
+template <size_t N, typename Word>
+constexpr std::array<uint8_t, N> constexpr_digest(std::string_view data,
+                                                  const Word* init_hash) {
+  constexpr size_t block_size = WordTraits<Word>::BLOCK_SIZE;
+  constexpr size_t length_size = 2 * sizeof(Word);
+  Word hash_values[8] = {};
+  for (int i = 0; i < 8; i++) {
+    hash_values[i] = init_hash[i];
+  }
+
+  uint8_t block[block_size] = {};
+  size_t offset = 0;
+  for (; data.size() - offset >= block_size; offset += block_size) {
+    for (size_t i = 0; i < block_size; i++) {
+      block[i] = static_cast<uint8_t>(data[offset + i]);
+    }
+    constexpr_compress(hash_values, block);
+  }
+
+  const size_t tail_len = data.size() - offset;
+  for (size_t i = 0; i < block_size; i++) {
+    block[i] = i < tail_len ? static_cast<uint8_t>(data[offset + i]) : 0;
+  }
+  block[tail_len] = 0x80;
+  if (tail_len + 1 + length_size > block_size) {
+    constexpr_compress(hash_values, block);
+    for (size_t i = 0; i < block_size; i++) {
+      block[i] = 0;
+    }
+  }
+  const uint64_t bit_len = static_cast<uint64_t>(data.size()) * 8;
+  for (size_t i = 0; i < 8; i++) {
+    block[block_size - 1 - i] = static_cast<uint8_t>(bit_len >> (8 * i));
+  }
+  if (length_size == 16) {
+    block[block_size - 9] = static_cast<uint8_t>(data.size() >> 61);
+  }
+  constexpr_compress(hash_values, block);
+
+  std::array<uint8_t, N> digest = {};
+  for (size_t i = 0; i < N; i++) {
+    const size_t shift = 8 * (sizeof(Word) - 1 - i % sizeof(Word));
+    digest[i] = static_cast<uint8_t>(hash_values[i / sizeof(Word)] >> shift);
+  }
+  return digest;
+}
+#endif
+}  // namespace detail
+
+// Lowercase hexadecimal digits used by hex_encode.
+static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+// Writes the lowercase hexadecimal representation of `len` bytes of `data` to
+// `out`, which must have room for 2 * len characters. No terminating NUL is
+// written.
+inline void hex_encode(const uint8_t* data, size_t len, char* out) {
+  for (size_t i = 0; i < len; i++) {
+    *out++ = HEX_DIGITS[data[i] >> 4];
+    *out++ = HEX_DIGITS[data[i] & 0x0f];
+  }
+}
+
+// Decodes the `len` hexadecimal digits at `hex`, in either case, to `out`,
+// which must have room for len / 2 bytes. Returns false if `len` is odd or a
+// character is not a hexadecimal digit; `out` may be partly written then.
+inline bool hex_decode(const char* hex, size_t len, uint8_t* out) {
+  if (len % 2 != 0) {
+    return false;
+  }
+  for (size_t i = 0; i < len; i++) {
+    char c = hex[i];
+    uint8_t nibble;
+    if (c >= '0' && c <= '9') {
+      nibble = static_cast<uint8_t>(c - '0');
+    } else if (c >= 'a' && c <= 'f') {
+      nibble = static_cast<uint8_t>(c - 'a' + 10);
+    } else if (c >= 'A' && c <= 'F') {
+      nibble = static_cast<uint8_t>(c - 'A' + 10);
+    } else {
+      return false;
+    }
+    if (i % 2 == 0) {
+      out[i / 2] = static_cast<uint8_t>(nibble << 4);
+    } else {
+      out[i / 2] |= nibble;
+    }
+  }
+  return true;
+}
+
+// Returns whether the `len` bytes at `a` and `b` are equal. The differences
+// of whole words are OR-ed together without a branch, so the time taken
+// depends only on `len` and not on where the bytes first differ; comparing a
+// computed digest or MAC with an untrusted one this way leaks nothing about
+// how much of it was right.
+inline bool constant_time_equal(const void* a, const void* b, size_t len) {
+  const uint8_t* x = static_cast<const uint8_t*>(a);
+  const uint8_t* y = static_cast<const uint8_t*>(b);
+  uint64_t diff = 0;
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t u, v;
+    std::memcpy(&u, x + i, 8);
+    std::memcpy(&v, y + i, 8);
+    diff |= u ^ v;
+  }
+  for (; i < len; i++) {
+    diff |= static_cast<uint64_t>(x[i] ^ y[i]);
+  }
+  return diff == 0;
+}
+
+// Identifies a SHA-2 algorithm for interfaces that choose it at run time.
+enum class Algorithm {
+  SHA224,
+  SHA256,
+  SHA384,
+  SHA512,
+  SHA512_224,
+  SHA512_256,
+};
+
+// The number of Algorithm values.
+static const size_t ALGORITHM_COUNT = 6;
+
+namespace detail {
+
+// The layout of the statistics of SHA_ENABLE_STATS builds, see sha_stats.h.
+// A message of n bytes falls in the first size bucket whose limit is at
+// least n, or in the last one.
+static const size_t STATS_BUCKETS = 7;
+static constexpr uint64_t STATS_BUCKET_LIMITS[STATS_BUCKETS - 1] = {
+    64, 256, 1024, 4096, 65536, 1 << 20};
+
+// The timed phases of a hash.
+enum StatsPhase {
+  STATS_COMPRESS,   // Block compression, by the active backend.
+  STATS_PAD,        // Building the padded final block(s).
+  STATS_SERIALIZE,  // Converting the hash values to digest bytes.
+  STATS_HEX,        // Formatting a digest as hexadecimal.
+  STATS_PHASES
+};
+
+// The counters kept per algorithm, as indices into ThreadStats::values.
+enum StatsField {
+  STATS_BYTES = STATS_PHASES,  // Bytes fed to the hash.
+  STATS_BLOCKS,                // Blocks compressed.
+  STATS_MESSAGE_BYTES,         // Total size of the completed messages.
+  STATS_CALLS,                 // STATS_BUCKETS message counts follow.
+  STATS_FIELDS = STATS_CALLS + STATS_BUCKETS
+};
+}  // namespace detail
+
+#ifdef SHA_ENABLE_STATS
+namespace detail {
+
+// Returns a timestamp for the phase totals: the time stamp counter on x86,
+// nanoseconds elsewhere.
+inline uint64_t stats_ticks() {
+#ifdef SHA_HAVE_X86_KERNELS
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+struct ThreadStats;
+
+// The counters of all threads: the live per-thread blocks and the totals
+// left behind by threads that have exited, less the baseline taken by the
+// last reset. It is never destroyed, so threads may exit during shutdown.
+struct StatsRegistry {
+  std::mutex mutex;
+  std::vector<ThreadStats*> threads;
+  uint64_t retired[ALGORITHM_COUNT][STATS_FIELDS] = {};
+  uint64_t baseline[ALGORITHM_COUNT][STATS_FIELDS] = {};
+};
+
+inline StatsRegistry& stats_registry() {
+  static StatsRegistry* registry = new StatsRegistry();
+  return *registry;
+}
+
+// The counters of one thread. Only the owning thread writes them, so an
+// update is a plain load and store; readers of the registry load them
+// concurrently, hence the relaxed atomics.
+struct ThreadStats {
+  ThreadStats() : current(-1) {
+    for (auto& fields : values) {
+      for (auto& value : fields) {
+        value.store(0, std::memory_order_relaxed);
+      }
+    }
+    StatsRegistry& registry = stats_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.threads.push_back(this);
+  }
+
+  ~ThreadStats() {
+    StatsRegistry& registry = stats_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (size_t a = 0; a < ALGORITHM_COUNT; a++) {
+      for (size_t f = 0; f < STATS_FIELDS; f++) {
+        registry.retired[a][f] += values[a][f].load(std::memory_order_relaxed);
+      }
+    }
+    registry.threads.erase(std::find(registry.threads.begin(),
+                                     registry.threads.end(), this));
+  }
+
+  std::atomic<uint64_t> values[ALGORITHM_COUNT][STATS_FIELDS];
+  int current;  // The algorithm being hashed, or -1 outside any hash.
+};
+
+inline ThreadStats& thread_stats() {
+  thread_local ThreadStats stats;
+  return stats;
+}
+
+// Adds `count` to counter `field` of the algorithm being hashed.
+inline void stats_add(size_t field, uint64_t count) {
+  ThreadStats& stats = thread_stats();
+  if (stats.current < 0) {
+    return;
+  }
+  std::atomic<uint64_t>& value = stats.values[stats.current][field];
+  value.store(value.load(std::memory_order_relaxed) + count,
+              std::memory_order_relaxed);
+}
+
+// Counts a completed message of `size` bytes in its size bucket.
+inline void stats_message(uint64_t size) {
+  size_t bucket = 0;
+  while (bucket < STATS_BUCKETS - 1 && size > STATS_BUCKET_LIMITS[bucket]) {
+    bucket++;
+  }
+  stats_add(STATS_CALLS + bucket, 1);
+  stats_add(STATS_MESSAGE_BYTES, size);
+}
+
+// Attributes the counters of the enclosing scope to `algorithm`. Scopes
+// nest, e.g. when an HMAC hashes with its inner and outer contexts.
+class StatsScope {
+ public:
+  explicit StatsScope(Algorithm algorithm)
+      : stats(thread_stats()), previous(stats.current) {
+    stats.current = static_cast<int>(algorithm);
+  }
+  ~StatsScope() { stats.current = previous; }
+
+ private:
+  ThreadStats& stats;
+  int previous;
+};
+
+// Adds the ticks spent in the enclosing scope to the total of `phase`.
+class PhaseTimer {
+ public:
+  explicit PhaseTimer(StatsPhase phase) : phase(phase), start(stats_ticks()) {}
+  ~PhaseTimer() { stats_add(phase, stats_ticks() - start); }
+
+ private:
+  StatsPhase phase;
+  uint64_t start;
+};
+}  // namespace detail
+#endif  // SHA_ENABLE_STATS
+
+// A raw digest of any SHA-2 algorithm: the first `size` bytes of `bytes` hold
+// the digest and the rest are zero.
+struct AnyDigest {
+  std::array<uint8_t, 64> bytes;
+  size_t size;
+
+  AnyDigest() : bytes(), size(0) {}
+
+  // Converts the raw digest of a fixed-size algorithm, e.g. SHA256::Digest.
+  template <size_t N>
+  AnyDigest(const std::array<uint8_t, N>& digest) : bytes(), size(N) {
+    static_assert(N <= 64, "digest does not fit in AnyDigest");
+    std::copy(digest.begin(), digest.end(), bytes.begin());
+  }
+
+  const uint8_t* data() const { return bytes.data(); }
+
+  // Returns the digest as a lowercase hexadecimal string.
+  std::string hex() const {
+    std::string hex(size * 2, '\0');
+    hex_encode(bytes.data(), size, &hex[0]);
+    return hex;
+  }
+
+  // Writes the digest in hexadecimal to `out`, which must have room for
+  // 2 * size characters, and returns the number of characters written. No
+  // terminating NUL is written.
+  size_t hex(char* out) const {
+    hex_encode(bytes.data(), size, out);
+    return size * 2;
+  }
+
+  bool operator==(const AnyDigest& other) const {
+    return size == other.size &&
+           std::equal(bytes.begin(), bytes.begin() + size, other.bytes.begin());
+  }
+  bool operator!=(const AnyDigest& other) const { return !(*this == other); }
+};
+
+// A snapshot of a streaming context partway through a message, taken with
+// export_state() and resumed with import_state() of the same algorithm. It
+// holds the chaining values after the last full block, the message length so
+// far and the bytes of the incomplete block; it is plain data and can be
+// copied freely. serialize() and deserialize() convert it to a portable byte
+// string, so a computation can continue in another process or on another
+// machine.
+template <typename Word, size_t BlockSize>
+struct ContextState {
+  Algorithm algorithm;
+  Word hash_values[8];
+  uint64_t message_len;    // Bytes hashed so far.
+  uint8_t tail[BlockSize];  // The first message_len % BlockSize are valid.
+
+  // The size of a serialized state: a 4-byte magic "sha2", the algorithm,
+  // the big-endian hash values and message length, and the tail bytes.
+  static constexpr size_t HEADER_SIZE = 4 + 1 + 8 * sizeof(Word) + 8;
+  static constexpr size_t MAX_SERIALIZED_SIZE = HEADER_SIZE + BlockSize;
+
+  // Writes the serialized state to `out`, which must have room for
+  // MAX_SERIALIZED_SIZE bytes, and returns the number of bytes written.
+  size_t serialize(uint8_t* out) const {
+    const size_t tail_len = message_len % BlockSize;
+    std::memcpy(out, "sha2", 4);
+    out[4] = static_cast<uint8_t>(algorithm);
+    uint8_t* p = out + 5;
+    for (int i = 0; i < 8; i++) {
+      for (size_t b = sizeof(Word); b-- > 0;) {
+        *p++ = static_cast<uint8_t>(hash_values[i] >> (8 * b));
+      }
+    }
+    for (int b = 7; b >= 0; b--) {
+      *p++ = static_cast<uint8_t>(message_len >> (8 * b));
+    }
+    std::memcpy(p, tail, tail_len);
+    return HEADER_SIZE + tail_len;
+  }
+
+  // Returns the serialized state.
+  std::string serialize() const {
+    uint8_t out[MAX_SERIALIZED_SIZE];
+    return std::string(reinterpret_cast<char*>(out), serialize(out));
+  }
+
+  // Parses a state written by serialize(). Returns false, leaving the state
+  // unchanged, if the bytes are not a serialized state of this word size.
+  bool deserialize(const void* data, size_t len) {
+    const uint8_t* in = static_cast<const uint8_t*>(data);
+    if (len < HEADER_SIZE || std::memcmp(in, "sha2", 4) != 0) {
+      return false;
+    }
+    const Algorithm parsed = static_cast<Algorithm>(in[4]);
+    const bool wide = parsed == Algorithm::SHA384 ||
+                      parsed == Algorithm::SHA512 ||
+                      parsed == Algorithm::SHA512_224 ||
+                      parsed == Algorithm::SHA512_256;
+    const bool narrow =
+        parsed == Algorithm::SHA224 || parsed == Algorithm::SHA256;
+    if (!(sizeof(Word) == 8 ? wide : narrow)) {
+      return false;
+    }
+    const uint8_t* p = in + 5 + 8 * sizeof(Word);
+    uint64_t length = 0;
+    for (int b = 0; b < 8; b++) {
+      length = (length << 8) | *p++;
+    }
+    const size_t tail_len = length % BlockSize;
+    if (len != HEADER_SIZE + tail_len) {
+      return false;
+    }
+
+    algorithm = parsed;
+    for (int i = 0; i < 8; i++) {
+      hash_values[i] = detail::load_word<Word>(in + 5 + i * sizeof(Word));
     }
-    return str_repr;
+    message_len = length;
+    std::memcpy(tail, p, tail_len);
+    return true;
+  }
+
+  // Parses a state written by serialize().
+  bool deserialize(const std::string& data) {
+    return deserialize(data.data(), data.size());
+  }
+};
+
+class SHABase {
+ protected:
+  // Stores a number into `out` in big-endian byte order.
+  template <typename Type>
+  static void store_big_endian(Type number, uint8_t* out) {
+    for (int i = sizeof(Type) - 1; i >= 0; i--) {
+      *out++ = (uint8_t)(number >> i * 8);
+    }
+  }
+
+  // Loads a big-endian number from the bytes at `data`.
+  template <typename Type>
+  static Type load_big_endian(const uint8_t* data) {
+    return detail::load_word<Type>(data);
+  }
+
+  // Converts a digest to its hexadecimal representation.
+  template <size_t N>
+  static std::string to_hex(const std::array<uint8_t, N>& digest) {
+    SHA_STATS_PHASE(HEX);
+    std::string hex(N * 2, '\0');
+    hex_encode(digest.data(), N, &hex[0]);
+    return hex;
+  }
+
+  // Writes the hexadecimal representation of a digest to `out`, which must
+  // have room for 2 * N characters.
+  template <size_t N>
+  static void to_hex(const std::array<uint8_t, N>& digest, char* out) {
+    SHA_STATS_PHASE(HEX);
+    hex_encode(digest.data(), N, out);
+  }
+
+  // Serializes the leading N bytes of the hash values in big-endian order.
+  // Whole words are stored at once; only a truncated last word, as in
+  // SHA-512/224, is written byte by byte.
+  template <size_t N, typename Type>
+  static std::array<uint8_t, N> to_digest(const Type* hash_values) {
+    SHA_STATS_PHASE(SERIALIZE);
+    std::array<uint8_t, N> digest;
+    for (size_t i = 0; i < N / sizeof(Type); i++) {
+      store_big_endian<Type>(hash_values[i], digest.data() + i * sizeof(Type));
+    }
+    for (size_t i = N / sizeof(Type) * sizeof(Type); i < N; i++) {
+      size_t shift = (sizeof(Type) - 1 - i % sizeof(Type)) * 8;
+      digest[i] = (uint8_t)(hash_values[i / sizeof(Type)] >> shift);
+    }
+    return digest;
   }
 
   // Computes the 'ch' function for hash computations.
   template <typename Type>
-  constexpr Type ch(Type x, Type y, Type z) const {
+  static constexpr Type ch(Type x, Type y, Type z) {
     return (x & y) ^ ((~x) & z);
   }
 
   // Computes the 'maj' function for hash computations.
   template <typename Type>
-  constexpr Type maj(Type x, Type y, Type z) const {
+  static constexpr Type maj(Type x, Type y, Type z) {
     static_assert(std::is_integral<Type>::value,
                   "Type must be an integral type");
     return (x & y) ^ (x & z) ^ (y & z);
@@ -178,281 +1557,1436 @@ class SHABase {
 
   // Performs a right bitwise rotation.
   template <typename Type>
-  constexpr Type RotR(Type a, short n) const {
+  static constexpr Type RotR(Type a, short n) {
     return (a >> n) | (a << (sizeof(Type) * 8 - n));
   }
 
   // Performs a right arithmetic shift.
   template <typename Type>
-  constexpr Type ShR(Type a, short n) const {
+  static constexpr Type ShR(Type a, short n) {
     return a >> n;
   }
 };
 
-class SHA256 : public SHABase {
- private:
-  // Pads and formats input data to a multiple of 512 bits with length encoding.
-  std::string prepare_input(const char* data) const {
-    uint64_t len = strlen(data);  // Length of input data
-    uint64_t total_len =
-        len + 8 + 1;  // Length including size and padding for 1 byte
-    size_t pad_len = ((total_len / 64) + 1) * 64 - total_len;
-    std::string preprocessed_data;
-    preprocessed_data.reserve(total_len + pad_len);
-    preprocessed_data.append(data);
-    preprocessed_data.push_back(0b10000000);
+namespace detail {
+
+// Returns whether the `a_len` bytes at `a` and the `b_len` bytes at `b`
+// share any byte.
+inline bool ranges_overlap(const void* a, size_t a_len, const void* b,
+                           size_t b_len) {
+  const uintptr_t a_begin = reinterpret_cast<uintptr_t>(a);
+  const uintptr_t b_begin = reinterpret_cast<uintptr_t>(b);
+  return a_len != 0 && b_len != 0 && a_begin < b_begin + b_len &&
+         b_begin < a_begin + a_len;
+}
+
+// The block-level machinery shared by every algorithm with the same word
+// size: the compression backends and their runtime selection, the final-block
+// padding and the multi-buffer driver of hash_many. SHA-256 and SHA-224 use
+// Engine<uint32_t>; SHA-512 and its truncated variants use Engine<uint64_t>,
+// so selecting a backend affects the whole family.
+template <typename Word>
+class Engine : public SHABase {
+ public:
+  typedef WordTraits<Word> Traits;
+  static constexpr size_t BLOCK_SIZE = Traits::BLOCK_SIZE;
+
+  // The most lanes a multi-buffer backend can have: one 512-bit register of
+  // words.
+  static constexpr size_t MAX_LANES = 64 / sizeof(Word);
+
+  // Returns the compression backends compiled into this build in order of
+  // preference and stores their number in `count`. The last entry is always
+  // the portable implementation.
+  static const CompressBackend<Word>* backends(size_t* count);
+
+  // Returns the multi-buffer backends compiled into this build in order of
+  // preference and stores their number in `count`. The last entry is always
+  // the serial fallback.
+  static const MultiBufferBackend<Word>* multi_backends(size_t* count);
+
+  // Returns the backend currently used by the family.
+  static const CompressBackend<Word>& backend() {
+    return *active_backend().load(std::memory_order_relaxed);
+  }
+
+  // Selects the backend with the given name for the family. Returns false,
+  // leaving the selection unchanged, if no such backend exists or the running
+  // CPU does not support it.
+  static bool set_backend(const char* name) {
+    size_t count;
+    const CompressBackend<Word>* list = backends(&count);
+    for (size_t i = 0; i < count; i++) {
+      if (std::strcmp(list[i].name, name) == 0 && list[i].supported()) {
+        active_backend().store(&list[i], std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Returns the multi-buffer backend currently used by hash_many.
+  static const MultiBufferBackend<Word>& multi_backend() {
+    return *active_multi_backend().load(std::memory_order_relaxed);
+  }
+
+  // Selects the multi-buffer backend with the given name for hash_many of the
+  // family. Returns false, leaving the selection unchanged, if no such
+  // backend exists or the running CPU does not support it.
+  static bool set_multi_backend(const char* name) {
+    size_t count;
+    const MultiBufferBackend<Word>* list = multi_backends(&count);
+    for (size_t i = 0; i < count; i++) {
+      if (std::strcmp(list[i].name, name) == 0 && list[i].supported()) {
+        active_multi_backend().store(&list[i], std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Processes `count` consecutive blocks with the active backend.
+  static void compress(Word* hash_values, const uint8_t* blocks,
+                       size_t count) {
+    SHA_STATS_PHASE(COMPRESS);
+    SHA_STATS_BLOCKS(count);
+    backend().compress(hash_values, blocks, count);
+  }
+
+  // Writes the last `tail_len` bytes of a `message_len` byte message followed
+  // by its padding to `out` and returns the number of blocks written (1 or 2).
+  // The padding ends in the message length in bits, stored in 8 bytes for
+  // 64-byte blocks and in 16 bytes for 128-byte blocks. `tail_len` may exceed
+  // a block as long as the tail and its padding fit in two blocks.
+  static size_t pad_final_blocks(const uint8_t* tail, size_t tail_len,
+                                 uint64_t message_len, uint8_t* out) {
+    SHA_STATS_PHASE(PAD);
+    const size_t length_size = 2 * sizeof(Word);
+    if (tail_len != 0) {
+      std::memcpy(out, tail, tail_len);
+    }
+    out[tail_len] = 0b10000000;
+    size_t blocks = tail_len + 1 + length_size > BLOCK_SIZE ? 2 : 1;
+    size_t end = blocks * BLOCK_SIZE;
+    std::memset(out + tail_len + 1, 0, end - 8 - tail_len - 1);
+    if (length_size == 16) {
+      store_big_endian<uint64_t>(message_len >> 61, out + end - 16);
+    }
+    store_big_endian<uint64_t>(message_len * 8, out + end - 8);
+    return blocks;
+  }
+
+  // Returns the number of blocks that a `len` byte message fills once
+  // padded, as pad_final_blocks() pads its tail.
+  static size_t padded_blocks(size_t len) {
+    return (len + 1 + 2 * sizeof(Word) + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  }
+
+  // The longest message that hash_message() pads whole on the stack: 119
+  // bytes for 64-byte blocks and 239 bytes for 128-byte blocks.
+  static const size_t MAX_SHORT_MESSAGE = 2 * BLOCK_SIZE - 2 * sizeof(Word) - 1;
+
+  // Computes the hash values of the `len` byte message at `data` from the
+  // initial hash values `init_hash` without a streaming context. Messages of
+  // up to MAX_SHORT_MESSAGE bytes are copied next to their padding and
+  // compressed with a single backend call; longer ones are compressed in
+  // place and only the tail is copied.
+  static void hash_message(const uint8_t* data, size_t len,
+                           const Word* init_hash, Word* hash_values) {
+    SHA_STATS_BYTES(len);
+    SHA_STATS_MESSAGE(len);
+    std::memcpy(hash_values, init_hash, 8 * sizeof(Word));
+    uint8_t blocks[2 * BLOCK_SIZE];
+    if (len <= MAX_SHORT_MESSAGE) {
+      compress(hash_values, blocks, pad_final_blocks(data, len, len, blocks));
+      return;
+    }
+    size_t full = len / BLOCK_SIZE;
+    compress(hash_values, data, full);
+    compress(hash_values, blocks,
+             pad_final_blocks(data + full * BLOCK_SIZE, len % BLOCK_SIZE, len,
+                              blocks));
+  }
+
+  // The padding block that ends a message of `Len` bytes, a multiple of
+  // BLOCK_SIZE, together with the sums of its expanded schedule and the round
+  // constants. The block holds no message bytes, so it is the same for every
+  // such message and is expanded once.
+  template <size_t Len>
+  struct PaddingBlock {
+    PaddingBlock() {
+      pad_final_blocks(nullptr, 0, Len, block);
+      Word w[Traits::ROUNDS];
+      for (int i = 0; i < 16; i++) {
+        w[i] = load_word<Word>(block + i * sizeof(Word));
+      }
+      for (int i = 16; i < Traits::ROUNDS; i++) {
+        w[i] = small_sigma_1(w[i - 2]) + w[i - 7] + small_sigma_0(w[i - 15]) +
+               w[i - 16];
+      }
+      for (int i = 0; i < Traits::ROUNDS; i++) {
+        wk[i] = w[i] + Traits::k()[i];
+      }
+    }
+
+    static const PaddingBlock& get() {
+      static const PaddingBlock padding;
+      return padding;
+    }
+
+    uint8_t block[BLOCK_SIZE];
+    Word wk[Traits::ROUNDS];
+  };
+
+  // The schedule of the padded block of a `Len` byte message that fits one
+  // block with its padding and ends on a word boundary, e.g. a 32-byte
+  // digest. Words [Len / sizeof(Word), 16) of the block hold only padding and
+  // are the same for every such message, so `fixed[i]` collects, once, their
+  // contribution to schedule word i. Other lengths have no such schedule.
+  template <size_t Len, bool OneBlock = (Len % sizeof(Word) == 0 &&
+                                         Len + 1 + 2 * sizeof(Word) <=
+                                             BLOCK_SIZE)>
+  struct FixedSchedule {
+    static const bool AVAILABLE = false;
+    static void compress(Word*, const uint8_t*) {}
+  };
+
+  template <size_t Len>
+  struct FixedSchedule<Len, true> {
+    static const bool AVAILABLE = true;
+    static const int MESSAGE_WORDS = Len / sizeof(Word);
+
+    FixedSchedule() {
+      static const uint8_t message[Len] = {0};
+      uint8_t block[BLOCK_SIZE];
+      pad_final_blocks(message, Len, Len, block);
+      Word w[16];
+      for (int i = 0; i < 16; i++) {
+        w[i] = load_word<Word>(block + i * sizeof(Word));
+      }
+      // The message words are zero here, and so are their small sigmas, so
+      // summing every term whose word lies in the block leaves the part that
+      // the padding determines.
+      for (int i = 0; i < Traits::ROUNDS; i++) {
+        if (i < 16) {
+          fixed[i] = w[i];
+          continue;
+        }
+        fixed[i] = 0;
+        if (i - 16 < 16) {
+          fixed[i] += w[i - 16];
+        }
+        if (i - 15 < 16) {
+          fixed[i] += small_sigma_0(w[i - 15]);
+        }
+        if (i - 7 < 16) {
+          fixed[i] += w[i - 7];
+        }
+        if (i - 2 < 16) {
+          fixed[i] += small_sigma_1(w[i - 2]);
+        }
+      }
+    }
+
+    static const FixedSchedule& get() {
+      static const FixedSchedule schedule;
+      return schedule;
+    }
 
-    if (pad_len != 0) {
-      std::string bytes(pad_len, '\0');
-      preprocessed_data.append(bytes);
+    // Compresses the padded block of the message at `data` in software.
+    static void compress(Word* hash_values, const uint8_t* data) {
+      Unrolled<Word>::template compress_fixed<MESSAGE_WORDS>(hash_values, data,
+                                                             get().fixed);
     }
 
-    preprocessed_data.append(to_bit_string<uint64_t>(len * 8));
-    return preprocessed_data;
+    Word fixed[Traits::ROUNDS];
+  };
+
+  // Computes the hash values of a message of exactly `Len` bytes, e.g. a
+  // 64-byte Merkle node or a digest being hashed again, from `init_hash`.
+  // The software backends skip the schedule work that the padding
+  // determines: when the message fills whole blocks, the padding block is
+  // compressed from its expanded schedule, and when it fits one block with
+  // its padding, as a 32-byte digest does, the scalar backends take the
+  // padding words from FixedSchedule. Other lengths, and the other cases on
+  // the hardware backends, are padded at run time.
+  template <size_t Len>
+  static void hash_fixed(const uint8_t* data, const Word* init_hash,
+                         Word* hash_values) {
+    if (Len % BLOCK_SIZE != 0) {
+      // Only the scalar backends gain from it: the hardware backends expand
+      // the schedule themselves, and the AVX2 SHA-512 backend expands it in
+      // vector registers faster than the scalar rounds can skip the padding.
+      const CompressBackend<Word>& active = backend();
+      if (!FixedSchedule<Len>::AVAILABLE ||
+          (active.compress != Unrolled<Word>::compress &&
+           active.compress != compress_portable)) {
+        hash_message(data, Len, init_hash, hash_values);
+        return;
+      }
+      SHA_STATS_BYTES(Len);
+      SHA_STATS_MESSAGE(Len);
+      SHA_STATS_PHASE(COMPRESS);
+      SHA_STATS_BLOCKS(1);
+      std::memcpy(hash_values, init_hash, 8 * sizeof(Word));
+      FixedSchedule<Len>::compress(hash_values, data);
+      return;
+    }
+    SHA_STATS_BYTES(Len);
+    SHA_STATS_MESSAGE(Len);
+    std::memcpy(hash_values, init_hash, 8 * sizeof(Word));
+    compress(hash_values, data, Len / BLOCK_SIZE);
+    const PaddingBlock<Len>& padding = PaddingBlock<Len>::get();
+    const CompressBackend<Word>& active = backend();
+    if (active.compress_scheduled != nullptr) {
+      SHA_STATS_PHASE(COMPRESS);
+      SHA_STATS_BLOCKS(1);
+      active.compress_scheduled(hash_values, padding.wk);
+    } else {
+      compress(hash_values, padding.block, 1);
+    }
   }
 
-  // Processes a 512-bit block and updates the SHA-256 hash values.
-  void process_block(const std::vector<uint32_t>& data_in_uint32_t,
-                     size_t block_index, uint32_t* hash_values) const {
-    std::vector<uint32_t> words(64);
-    std::copy(data_in_uint32_t.begin() + (16 * block_index),
-              data_in_uint32_t.begin() + (16 * block_index) + 16,
-              words.begin());
+  // Computes the N-byte digests of `count` messages of exactly `Len` bytes,
+  // stored back to back at `inputs`, and stores them in `out`. If no Output
+  // is larger than a message, `out` may also point to `inputs` itself: each
+  // group of lanes reads its messages before it writes their digests, which
+  // then never reach the messages of the next group. Otherwise the two must
+  // not overlap. Whole-block messages share one padding block, which the
+  // lanes compress from its precomputed schedule.
+  template <size_t Len, size_t N, typename Output>
+  static void hash_fixed_many(const uint8_t* inputs, size_t count,
+                              Output* out, const Word* init_hash) {
+    assert((static_cast<const void*>(out) == inputs &&
+            sizeof(Output) <= Len) ||
+           !ranges_overlap(inputs, count * Len, out, count * sizeof(Output)));
+    const MultiBufferBackend<Word>& multi = multi_backend();
+    const size_t lanes = multi.lanes;
+    const size_t full_blocks = Len / BLOCK_SIZE;
+    const size_t tail_len = Len % BLOCK_SIZE;
+    static const uint8_t idle_block[BLOCK_SIZE] = {0};
+    Word state[8 * MAX_LANES];
+    uint8_t tails[MAX_LANES][2 * BLOCK_SIZE];
+    const uint8_t* blocks[MAX_LANES];
+
+    size_t first = 0;
+    while (lanes > 1 && count - first >= lanes / 2 + 1) {
+      size_t group = std::min(lanes, count - first);
+      size_t tail_blocks = 0;
+      for (size_t lane = 0; lane < lanes; lane++) {
+        for (int i = 0; i < 8; i++) {
+          state[i * lanes + lane] = init_hash[i];
+        }
+        if (lane < group && tail_len != 0) {
+          tail_blocks = pad_final_blocks(
+              inputs + (first + lane) * Len + full_blocks * BLOCK_SIZE,
+              tail_len, Len, tails[lane]);
+        }
+      }
+      SHA_STATS_BYTES(group * Len);
+      SHA_STATS_BLOCKS(group * (full_blocks + (tail_len != 0 ? tail_blocks
+                                                             : 1)));
+      for (size_t lane = 0; lane < group; lane++) {
+        SHA_STATS_MESSAGE(Len);
+      }
+
+      {
+        SHA_STATS_PHASE(COMPRESS);
+        for (size_t block = 0; block < full_blocks; block++) {
+          for (size_t lane = 0; lane < lanes; lane++) {
+            blocks[lane] = lane < group ? inputs + (first + lane) * Len +
+                                              block * BLOCK_SIZE
+                                        : idle_block;
+          }
+          multi.compress(state, blocks);
+        }
+        if (tail_len != 0) {
+          for (size_t block = 0; block < tail_blocks; block++) {
+            for (size_t lane = 0; lane < lanes; lane++) {
+              blocks[lane] =
+                  lane < group ? tails[lane] + block * BLOCK_SIZE : idle_block;
+            }
+            multi.compress(state, blocks);
+          }
+        } else {
+          multi.compress_scheduled(state, PaddingBlock<Len>::get().wk);
+        }
+      }
 
-    for (int i = 16; i < 64; i++) {
-      words[i] = small_sigma_1(words[i - 2]) + words[i - 7] +
-                 small_sigma_0(words[i - 15]) + words[i - 16];
+      for (size_t lane = 0; lane < group; lane++) {
+        Word hash_values[8];
+        for (int i = 0; i < 8; i++) {
+          hash_values[i] = state[i * lanes + lane];
+        }
+        out[first + lane] = to_digest<N>(hash_values);
+      }
+      first += group;
     }
 
-    uint32_t a = hash_values[0];
-    uint32_t b = hash_values[1];
-    uint32_t c = hash_values[2];
-    uint32_t d = hash_values[3];
-    uint32_t e = hash_values[4];
-    uint32_t f = hash_values[5];
-    uint32_t g = hash_values[6];
-    uint32_t h = hash_values[7];
+    for (; first < count; first++) {
+      Word hash_values[8];
+      hash_fixed<Len>(inputs + first * Len, init_hash, hash_values);
+      out[first] = to_digest<N>(hash_values);
+    }
+  }
+
+  // Hashes `count` independent messages from the initial hash values
+  // `init_hash` and writes the leading N bytes of each digest to `out`, whose
+  // elements are assigned from std::array<uint8_t, N>. Messages are ordered
+  // by their number of padded blocks and compressed in groups of `lanes` with
+  // the active multi-buffer backend, so the lanes of a group finish at about
+  // the same time.
+  template <size_t N, typename Input, typename Output>
+  static void hash_many(const Input* inputs, size_t count, Output* out,
+                        const Word* init_hash) {
+    const MultiBufferBackend<Word>& multi = multi_backend();
+    const size_t lanes = multi.lanes;
+    // The message order is the only scratch that depends on the batch size.
+    // It is pooled per thread, so repeated batches do not allocate once the
+    // largest batch of the thread has been seen.
+    thread_local std::vector<size_t> order;
+    order.resize(count);
+    for (size_t i = 0; i < count; i++) {
+      order[i] = i;
+    }
+    if (lanes > 1) {
+      // std::sort, unlike std::stable_sort, needs no temporary buffer; ties
+      // are broken by index to keep the grouping deterministic.
+      std::sort(order.begin(), order.end(), [&](size_t x, size_t y) {
+        size_t x_blocks = padded_blocks(as_segment(inputs[x]).size);
+        size_t y_blocks = padded_blocks(as_segment(inputs[y]).size);
+        return x_blocks != y_blocks ? x_blocks < y_blocks : x < y;
+      });
+    }
 
-    for (int i = 0; i < 64; i++) {
-      uint32_t T1 = h + big_sigma_1(e) + ch(e, f, g) + SHA256_K[i] + words[i];
-      uint32_t T2 = big_sigma_0(a) + maj(a, b, c);
-      h = g;
-      g = f;
-      f = e;
-      e = d + T1;
-      d = c;
-      c = b;
-      b = a;
-      a = T1 + T2;
+    static const uint8_t idle_block[BLOCK_SIZE] = {0};
+    Word state[8 * MAX_LANES];
+    uint8_t tails[MAX_LANES][2 * BLOCK_SIZE];
+    const uint8_t* blocks[MAX_LANES];
+    const uint8_t* data[MAX_LANES];
+    size_t full_blocks[MAX_LANES];
+    size_t total_blocks[MAX_LANES];
+
+    size_t first = 0;
+    while (lanes > 1 && count - first >= lanes / 2 + 1) {
+      size_t group = std::min(lanes, count - first);
+      size_t max_blocks = 0;
+      for (size_t lane = 0; lane < lanes; lane++) {
+        for (int i = 0; i < 8; i++) {
+          state[i * lanes + lane] = init_hash[i];
+        }
+        total_blocks[lane] = 0;
+        if (lane >= group) {
+          continue;
+        }
+        Segment input = as_segment(inputs[order[first + lane]]);
+        data[lane] = static_cast<const uint8_t*>(input.data);
+        full_blocks[lane] = input.size / BLOCK_SIZE;
+        total_blocks[lane] =
+            full_blocks[lane] +
+            pad_final_blocks(data[lane] + full_blocks[lane] * BLOCK_SIZE,
+                             input.size % BLOCK_SIZE, input.size,
+                             tails[lane]);
+        max_blocks = std::max(max_blocks, total_blocks[lane]);
+        SHA_STATS_BYTES(input.size);
+        SHA_STATS_BLOCKS(total_blocks[lane]);
+        SHA_STATS_MESSAGE(input.size);
+      }
+
+      for (size_t block = 0; block < max_blocks; block++) {
+        for (size_t lane = 0; lane < lanes; lane++) {
+          if (lane < group && block < full_blocks[lane]) {
+            blocks[lane] = data[lane] + block * BLOCK_SIZE;
+          } else if (block < total_blocks[lane]) {
+            blocks[lane] =
+                tails[lane] + (block - full_blocks[lane]) * BLOCK_SIZE;
+          } else {
+            blocks[lane] = idle_block;
+          }
+        }
+        {
+          SHA_STATS_PHASE(COMPRESS);
+          multi.compress(state, blocks);
+        }
+        for (size_t lane = 0; lane < group; lane++) {
+          if (block + 1 == total_blocks[lane]) {
+            Word hash_values[8];
+            for (int i = 0; i < 8; i++) {
+              hash_values[i] = state[i * lanes + lane];
+            }
+            out[order[first + lane]] = to_digest<N>(hash_values);
+          }
+        }
+      }
+      first += group;
     }
 
-    hash_values[0] += a;
-    hash_values[1] += b;
-    hash_values[2] += c;
-    hash_values[3] += d;
-    hash_values[4] += e;
-    hash_values[5] += f;
-    hash_values[6] += g;
-    hash_values[7] += h;
+    // Too few messages are left to fill the lanes; hash them one at a time.
+    for (; first < count; first++) {
+      Segment input = as_segment(inputs[order[first]]);
+      Word hash_values[8];
+      hash_message(static_cast<const uint8_t*>(input.data), input.size,
+                   init_hash, hash_values);
+      out[order[first]] = to_digest<N>(hash_values);
+    }
   }
 
-  // Applies the big_sigma_0 function as defined by SHA-256 to input x
-  constexpr uint32_t big_sigma_0(uint32_t x) const {
-    return RotR<uint32_t>(x, 2) ^ RotR<uint32_t>(x, 13) ^ RotR<uint32_t>(x, 22);
+ private:
+  // Applies the big_sigma_0 function of the family to input x.
+  static constexpr Word big_sigma_0(Word x) {
+    return RotR<Word>(x, Traits::BIG_SIGMA_0_A) ^
+           RotR<Word>(x, Traits::BIG_SIGMA_0_B) ^
+           RotR<Word>(x, Traits::BIG_SIGMA_0_C);
   }
 
-  // Applies the big_sigma_1 function as defined by SHA-256 to input x
-  constexpr uint32_t big_sigma_1(uint32_t x) const {
-    return RotR<uint32_t>(x, 6) ^ RotR<uint32_t>(x, 11) ^ RotR<uint32_t>(x, 25);
+  // Applies the big_sigma_1 function of the family to input x.
+  static constexpr Word big_sigma_1(Word x) {
+    return RotR<Word>(x, Traits::BIG_SIGMA_1_A) ^
+           RotR<Word>(x, Traits::BIG_SIGMA_1_B) ^
+           RotR<Word>(x, Traits::BIG_SIGMA_1_C);
   }
 
-  // Applies the small_sigma_0 function as defined by SHA-256 to input x
-  constexpr uint32_t small_sigma_0(uint32_t x) const {
-    return RotR<uint32_t>(x, 7) ^ RotR<uint32_t>(x, 18) ^ ShR<uint32_t>(x, 3);
+  // Applies the small_sigma_0 function of the family to input x.
+  static constexpr Word small_sigma_0(Word x) {
+    return RotR<Word>(x, Traits::SMALL_SIGMA_0_A) ^
+           RotR<Word>(x, Traits::SMALL_SIGMA_0_B) ^
+           ShR<Word>(x, Traits::SMALL_SIGMA_0_SHIFT);
   }
 
-  // Applies the small_sigma_1 function as defined by SHA-256 to input x
-  constexpr uint32_t small_sigma_1(uint32_t x) const {
-    return RotR<uint32_t>(x, 17) ^ RotR<uint32_t>(x, 19) ^ ShR<uint32_t>(x, 10);
+  // Applies the small_sigma_1 function of the family to input x.
+  static constexpr Word small_sigma_1(Word x) {
+    return RotR<Word>(x, Traits::SMALL_SIGMA_1_A) ^
+           RotR<Word>(x, Traits::SMALL_SIGMA_1_B) ^
+           ShR<Word>(x, Traits::SMALL_SIGMA_1_SHIFT);
   }
 
- protected:
-  // Computes the SHA-256 hash of the input data using the given initial hash
-  // values and returns the result as a hexadecimal string.
-  std::string __hash(const char* data, const uint32_t* init_hash) const {
-    uint32_t hash_vals[8];
-    std::memcpy(hash_vals, init_hash, 32);
-    std::string preprocessed_data = prepare_input(data);
-    std::vector<uint32_t> data_in_uint32_t =
-        to_integral_vector<uint32_t>(preprocessed_data);
-    size_t N = preprocessed_data.size() / 64;
-    for (int block = 0; block < N; block++) {
-      process_block(data_in_uint32_t, block, hash_vals);
-    }
-    std::string hashed_value = to_string(hash_vals);
-    return to_hex(hashed_value);
+  // Processes `count` consecutive blocks and updates the hash values. This is
+  // the portable fallback used when no accelerated backend is available.
+  static void compress_portable(Word* hash_values, const uint8_t* blocks,
+                                size_t count) {
+    for (; count != 0; count--, blocks += BLOCK_SIZE) {
+      std::array<Word, Traits::ROUNDS> words;
+      for (int i = 0; i < 16; i++) {
+        words[i] = load_big_endian<Word>(blocks + i * sizeof(Word));
+      }
+
+      for (int i = 16; i < Traits::ROUNDS; i++) {
+        words[i] = small_sigma_1(words[i - 2]) + words[i - 7] +
+                   small_sigma_0(words[i - 15]) + words[i - 16];
+      }
+
+      Word a = hash_values[0];
+      Word b = hash_values[1];
+      Word c = hash_values[2];
+      Word d = hash_values[3];
+      Word e = hash_values[4];
+      Word f = hash_values[5];
+      Word g = hash_values[6];
+      Word h = hash_values[7];
+
+      for (int i = 0; i < Traits::ROUNDS; i++) {
+        Word T1 = h + big_sigma_1(e) + ch<Word>(e, f, g) + Traits::k()[i] +
+                  words[i];
+        Word T2 = big_sigma_0(a) + maj<Word>(a, b, c);
+        h = g;
+        g = f;
+        f = e;
+        e = d + T1;
+        d = c;
+        c = b;
+        b = a;
+        a = T1 + T2;
+      }
+
+      hash_values[0] += a;
+      hash_values[1] += b;
+      hash_values[2] += c;
+      hash_values[3] += d;
+      hash_values[4] += e;
+      hash_values[5] += f;
+      hash_values[6] += g;
+      hash_values[7] += h;
+    }
   }
 
- public:
-  // Computes the SHA-256 hash of the input data using optional initial hash
-  // values.
-  std::string hash(const char* data) const {
-    return __hash(data, CONST_SHA256_H);
+  // Reports that the portable backend runs on every CPU.
+  static bool always_supported() { return true; }
+
+  // Returns the backend that contexts start from: the first entry of
+  // backends() that the running CPU supports.
+  static const CompressBackend<Word>* default_backend() {
+    size_t count;
+    const CompressBackend<Word>* list = backends(&count);
+    for (size_t i = 0; i < count; i++) {
+      if (list[i].supported()) {
+        return &list[i];
+      }
+    }
+    return &list[count - 1];
   }
-};
 
-class SHA224 : public SHA256 {
- public:
-  // Computes a SHA-224 hash from input data.
-  std::string hash(const char* data) const {
-    std::string hashed_digest = __hash(data, CONST_SHA224_H);
-    hashed_digest.resize(56);
-    return hashed_digest;
+  // Holds the backend used by all contexts of the family.
+  static std::atomic<const CompressBackend<Word>*>& active_backend() {
+    static std::atomic<const CompressBackend<Word>*> active(
+        default_backend());
+    return active;
+  }
+
+  // Returns the backend that hash_many starts from: the first entry of
+  // multi_backends() that the running CPU supports. A single SHA-NI stream
+  // keeps up with the vector lanes, so the serial path is used when SHA-NI is
+  // the active compression backend. The AVX2 SHA-512 stream does not: four
+  // AVX2 lanes still hash small messages about 1.3 to 1.6 times faster.
+  static const MultiBufferBackend<Word>* default_multi_backend() {
+    size_t count;
+    const MultiBufferBackend<Word>* list = multi_backends(&count);
+    if (std::strcmp(backend().name, "sha-ni") == 0) {
+      return &list[count - 1];
+    }
+    for (size_t i = 0; i < count; i++) {
+      if (list[i].supported()) {
+        return &list[i];
+      }
+    }
+    return &list[count - 1];
+  }
+
+  // Holds the multi-buffer backend used by hash_many.
+  static std::atomic<const MultiBufferBackend<Word>*>& active_multi_backend() {
+    static std::atomic<const MultiBufferBackend<Word>*> active(
+        default_multi_backend());
+    return active;
   }
 };
 
-class SHA512 : public SHABase {
+// The backend tables, in order of preference.
+#ifdef SHA_DEFINE_DISPATCH
+template <>
+SHA_LIBRARY_INLINE const CompressBackend<uint32_t>*
+Engine<uint32_t>::backends(size_t* count) {
+  static const CompressBackend<uint32_t> list[] = {
+#ifdef SHA_HAVE_X86_KERNELS
+      {"sha-ni", sha256_compress_shani, cpu_has_sha_ni, nullptr},
+#endif
+#ifdef SHA_HAVE_ARM_KERNELS
+      {"armv8-sha2", sha256_compress_armv8, cpu_has_arm_sha2, nullptr},
+#endif
+      {"unrolled", Unrolled<uint32_t>::compress, always_supported,
+       Unrolled<uint32_t>::compress_scheduled},
+      {"portable", compress_portable, always_supported,
+       Unrolled<uint32_t>::compress_scheduled},
+  };
+  *count = sizeof(list) / sizeof(list[0]);
+  return list;
+}
+
+template <>
+SHA_LIBRARY_INLINE const MultiBufferBackend<uint32_t>*
+Engine<uint32_t>::multi_backends(size_t* count) {
+  static const MultiBufferBackend<uint32_t> list[] = {
+#ifdef SHA_HAVE_X86_KERNELS
+      {"avx512", 16, sha256_compress_x16_avx512, cpu_has_avx512f,
+       sha256_compress_x16_avx512_scheduled},
+      {"avx2", 8, sha256_compress_x8_avx2, cpu_has_avx2,
+       sha256_compress_x8_avx2_scheduled},
+#endif
+      {"serial", 1, nullptr, always_supported, nullptr},
+  };
+  *count = sizeof(list) / sizeof(list[0]);
+  return list;
+}
+
+template <>
+SHA_LIBRARY_INLINE const CompressBackend<uint64_t>*
+Engine<uint64_t>::backends(size_t* count) {
+  static const CompressBackend<uint64_t> list[] = {
+#ifdef SHA_HAVE_X86_KERNELS
+      {"avx2", sha512_compress_avx2, cpu_has_avx2_bmi2,
+       Unrolled<uint64_t>::compress_scheduled},
+#endif
+#ifdef SHA_HAVE_ARM_KERNELS
+      {"armv8-sha512", sha512_compress_armv8, cpu_has_arm_sha512, nullptr},
+#endif
+      {"unrolled", Unrolled<uint64_t>::compress, always_supported,
+       Unrolled<uint64_t>::compress_scheduled},
+      {"portable", compress_portable, always_supported,
+       Unrolled<uint64_t>::compress_scheduled},
+  };
+  *count = sizeof(list) / sizeof(list[0]);
+  return list;
+}
+
+template <>
+SHA_LIBRARY_INLINE const MultiBufferBackend<uint64_t>*
+Engine<uint64_t>::multi_backends(size_t* count) {
+  static const MultiBufferBackend<uint64_t> list[] = {
+#ifdef SHA_HAVE_X86_KERNELS
+      {"avx512", 8, sha512_compress_x8_avx512, cpu_has_avx512f,
+       sha512_compress_x8_avx512_scheduled},
+      {"avx2", 4, sha512_compress_x4_avx2, cpu_has_avx2,
+       sha512_compress_x4_avx2_scheduled},
+#endif
+      {"serial", 1, nullptr, always_supported, nullptr},
+  };
+  *count = sizeof(list) / sizeof(list[0]);
+  return list;
+}
+#else
+template <>
+const CompressBackend<uint32_t>* Engine<uint32_t>::backends(size_t* count);
+template <>
+const MultiBufferBackend<uint32_t>* Engine<uint32_t>::multi_backends(
+    size_t* count);
+template <>
+const CompressBackend<uint64_t>* Engine<uint64_t>::backends(size_t* count);
+template <>
+const MultiBufferBackend<uint64_t>* Engine<uint64_t>::multi_backends(
+    size_t* count);
+#endif
+}  // namespace detail
+
+// The parameters of one SHA-2 algorithm for SHA2<Traits>: its word type,
+// digest size and initial hash values.
+struct SHA256Traits {
+  typedef uint32_t Word;
+  static constexpr size_t DIGEST_SIZE = 32;
+  static constexpr Algorithm ALGORITHM = Algorithm::SHA256;
+  static constexpr const Word* initial_hash() { return CONST_SHA256_H; }
+};
+struct SHA224Traits {
+  typedef uint32_t Word;
+  static constexpr size_t DIGEST_SIZE = 28;
+  static constexpr Algorithm ALGORITHM = Algorithm::SHA224;
+  static constexpr const Word* initial_hash() { return CONST_SHA224_H; }
+};
+struct SHA512Traits {
+  typedef uint64_t Word;
+  static constexpr size_t DIGEST_SIZE = 64;
+  static constexpr Algorithm ALGORITHM = Algorithm::SHA512;
+  static constexpr const Word* initial_hash() { return CONST_SHA512_H; }
+};
+struct SHA384Traits {
+  typedef uint64_t Word;
+  static constexpr size_t DIGEST_SIZE = 48;
+  static constexpr Algorithm ALGORITHM = Algorithm::SHA384;
+  static constexpr const Word* initial_hash() { return CONST_SHA384_H; }
+};
+struct SHA512_224Traits {
+  typedef uint64_t Word;
+  static constexpr size_t DIGEST_SIZE = 28;
+  static constexpr Algorithm ALGORITHM = Algorithm::SHA512_224;
+  static constexpr const Word* initial_hash() { return CONST_SHA512_224_H; }
+};
+struct SHA512_256Traits {
+  typedef uint64_t Word;
+  static constexpr size_t DIGEST_SIZE = 32;
+  static constexpr Algorithm ALGORITHM = Algorithm::SHA512_256;
+  static constexpr const Word* initial_hash() { return CONST_SHA512_256_H; }
+};
+
+// A SHA-2 hash function described by `Traits`. The compression, padding and
+// backend selection come from the Engine of the word size; the digest size
+// is a compile-time parameter, so truncated variants only serialize the words
+// they keep. The algorithms of FIPS 180-4 are the typedefs below.
+template <typename Traits>
+class SHA2 : public SHABase {
  private:
-  std::string prepare_input(const char* data) const {
-    size_t len = strlen(data);
-    uint64_t total_len = len + 8 + 1;
-    size_t pad_len = ((total_len / 128) + 1) * 128 - total_len;
-    std::string preprocessed_data;
-    preprocessed_data.reserve(total_len + pad_len);
-    preprocessed_data.append(data);
-    preprocessed_data.push_back(0b10000000);
+  typedef typename Traits::Word Word;
+  typedef detail::Engine<Word> Engine;
+
+  Word hash_vals[8];                   // Chaining state carried between blocks.
+  uint8_t buffer[Engine::BLOCK_SIZE];  // Pending bytes of the partial block.
+  size_t buffer_len;                   // Number of pending bytes in `buffer`.
+  uint64_t message_len;                // Total number of bytes fed so far.
 
-    if (pad_len != 0) {
-      std::string bytes(pad_len, '\0');
-      preprocessed_data.append(bytes);
+  // Processes `count` consecutive blocks with the active backend.
+  void process_blocks(const uint8_t* blocks, size_t count) {
+    Engine::compress(hash_vals, blocks, count);
+  }
+
+  // Pads the message and processes the final block(s).
+  void pad_message() {
+    uint8_t blocks[2 * Engine::BLOCK_SIZE];
+    process_blocks(blocks, Engine::pad_final_blocks(buffer, buffer_len,
+                                                    message_len, blocks));
+  }
+
+ public:
+  static constexpr size_t DIGEST_SIZE = Traits::DIGEST_SIZE;
+  static constexpr size_t BLOCK_SIZE = Engine::BLOCK_SIZE;
+  // The number of characters of the hexadecimal digest.
+  static constexpr size_t HEX_SIZE = 2 * DIGEST_SIZE;
+  typedef std::array<uint8_t, DIGEST_SIZE> Digest;
+
+  // The state captured by export_state().
+  typedef ContextState<Word, BLOCK_SIZE> State;
+
+  SHA2() { init(); }
+
+  // Returns the compression backends compiled into this build in order of
+  // preference and stores their number in `count`. The last entry is always
+  // the portable implementation.
+  static const CompressBackend<Word>* backends(size_t* count) {
+    return Engine::backends(count);
+  }
+
+  // Returns the backend currently used by every algorithm of this word size.
+  static const CompressBackend<Word>& backend() { return Engine::backend(); }
+
+  // Selects the backend with the given name for every algorithm of this word
+  // size. Returns false, leaving the selection unchanged, if no such backend
+  // exists or the running CPU does not support it.
+  static bool set_backend(const char* name) {
+    return Engine::set_backend(name);
+  }
+
+  // Returns the multi-buffer backends compiled into this build in order of
+  // preference and stores their number in `count`. The last entry is always
+  // the serial fallback.
+  static const MultiBufferBackend<Word>* multi_backends(size_t* count) {
+    return Engine::multi_backends(count);
+  }
+
+  // Returns the multi-buffer backend currently used by hash_many.
+  static const MultiBufferBackend<Word>& multi_backend() {
+    return Engine::multi_backend();
+  }
+
+  // Selects the multi-buffer backend with the given name for hash_many of
+  // every algorithm of this word size. Returns false, leaving the selection
+  // unchanged, if no such backend exists or the running CPU does not support
+  // it.
+  static bool set_multi_backend(const char* name) {
+    return Engine::set_multi_backend(name);
+  }
+
+  // Returns the algorithm computed by the context.
+  static constexpr Algorithm algorithm() { return Traits::ALGORITHM; }
+
+  // Resets the context so that a new message can be hashed.
+  void init() {
+    std::memcpy(hash_vals, Traits::initial_hash(), sizeof(hash_vals));
+    buffer_len = 0;
+    message_len = 0;
+  }
+
+  // Feeds the next `len` bytes of the message into the context. Only the
+  // trailing partial block is buffered; full blocks are processed in place.
+  void update(const void* data, size_t len) {
+    if (len == 0) {
+      return;
+    }
+    SHA_STATS_ALGORITHM(algorithm());
+    SHA_STATS_BYTES(len);
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    message_len += len;
+    if (buffer_len != 0) {
+      size_t fill = std::min(len, sizeof(buffer) - buffer_len);
+      std::memcpy(buffer + buffer_len, bytes, fill);
+      buffer_len += fill;
+      bytes += fill;
+      len -= fill;
+      if (buffer_len < sizeof(buffer)) {
+        return;
+      }
+      process_blocks(buffer, 1);
+      buffer_len = 0;
     }
+    size_t blocks = len / BLOCK_SIZE;
+    process_blocks(bytes, blocks);
+    bytes += blocks * BLOCK_SIZE;
+    len -= blocks * BLOCK_SIZE;
+    std::memcpy(buffer, bytes, len);
+    buffer_len = len;
+  }
+
+  // Feeds the `count` segments at `segments` into the context in order, as
+  // if they had been concatenated. Only a partial block that straddles a
+  // segment boundary is copied.
+  void update_segments(const Segment* segments, size_t count) {
+    update_each(segments, count);
+  }
+
+#ifdef SHA_HAS_IOVEC
+  // Feeds the `count` buffers of a scatter/gather array into the context in
+  // order, as if they had been concatenated.
+  void update_segments(const struct iovec* iov, size_t count) {
+    update_each(iov, count);
+  }
+#endif
+
+  // Pads the message and returns the hash as a hexadecimal string. The
+  // context is reset afterwards.
+  std::string finalize() {
+    SHA_STATS_ALGORITHM(algorithm());
+    return to_hex(finalize_digest());
+  }
 
-    preprocessed_data.append(to_bit_string<uint64_t>(len * 8));
-    return preprocessed_data;
+  // Pads the message and writes the hash in hexadecimal to `out`, which must
+  // have room for HEX_SIZE characters; no terminating NUL is written. The
+  // context is reset afterwards. Unlike finalize(), this never allocates.
+  void finalize(char* out) {
+    SHA_STATS_ALGORITHM(algorithm());
+    to_hex(finalize_digest(), out);
   }
 
-  void process_block(const std::vector<uint64_t>& data_in_uint64_t,
-                     size_t block_index, uint64_t* hash_values) const {
-    std::vector<uint64_t> words(80);
-    std::copy(data_in_uint64_t.begin() + (16 * block_index),
-              data_in_uint64_t.begin() + (16 * block_index) + 16,
-              words.begin());
+  // Pads the message and returns the raw digest. The context is reset
+  // afterwards.
+  Digest finalize_digest() {
+    SHA_STATS_ALGORITHM(algorithm());
+    SHA_STATS_MESSAGE(message_len);
+    pad_message();
+    Digest digest = to_digest<DIGEST_SIZE>(hash_vals);
+    init();
+    return digest;
+  }
+
+  // Captures the state of the message hashed so far, e.g. after a common
+  // prefix, so that it can be resumed any number of times.
+  State export_state() const {
+    State state;
+    state.algorithm = algorithm();
+    std::memcpy(state.hash_values, hash_vals, sizeof(hash_vals));
+    state.message_len = message_len;
+    std::memcpy(state.tail, buffer, buffer_len);
+    std::memset(state.tail + buffer_len, 0, sizeof(buffer) - buffer_len);
+    return state;
+  }
 
-    for (int i = 16; i < 80; i++) {
-      words[i] = small_sigma_1(words[i - 2]) + words[i - 7] +
-                 small_sigma_0(words[i - 15]) + words[i - 16];
+  // Continues the message captured in `state`. Returns false, leaving the
+  // context unchanged, if `state` was taken from another algorithm.
+  bool import_state(const State& state) {
+    if (state.algorithm != algorithm()) {
+      return false;
     }
+    std::memcpy(hash_vals, state.hash_values, sizeof(hash_vals));
+    message_len = state.message_len;
+    buffer_len = message_len % BLOCK_SIZE;
+    std::memcpy(buffer, state.tail, buffer_len);
+    return true;
+  }
+
+  // Computes the hash of `len` bytes of binary input data.
+  std::string hash(const uint8_t* data, size_t len) const {
+    SHA_STATS_ALGORITHM(algorithm());
+    return to_hex(digest(data, len));
+  }
+
+  // Computes the hash of `len` bytes of binary input data and writes it in
+  // hexadecimal to `out`, which must have room for HEX_SIZE characters; no
+  // terminating NUL is written. Neither the hash nor the output allocate, so
+  // a loop of calls does no heap traffic. A reused std::string works as the
+  // buffer after resize(HEX_SIZE).
+  void hash(const uint8_t* data, size_t len, char* out) const {
+    SHA_STATS_ALGORITHM(algorithm());
+    to_hex(digest(data, len), out);
+  }
 
-    uint64_t a = hash_values[0];
-    uint64_t b = hash_values[1];
-    uint64_t c = hash_values[2];
-    uint64_t d = hash_values[3];
-    uint64_t e = hash_values[4];
-    uint64_t f = hash_values[5];
-    uint64_t g = hash_values[6];
-    uint64_t h = hash_values[7];
+  // Computes the hash of the NUL-terminated input string.
+  std::string hash(const char* data) const {
+    return hash(reinterpret_cast<const uint8_t*>(data), strlen(data));
+  }
+
+  // Computes the hash of the input string, including any embedded NUL bytes.
+  std::string hash(const std::string& data) const {
+    return hash(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+  }
+
+#ifdef SHA_HAS_STRING_VIEW
+  // Computes the hash of the bytes viewed by `data`.
+  std::string hash(std::string_view data) const {
+    return hash(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+  }
+#endif
+
+#ifdef SHA_HAS_SPAN
+  // Computes the hash of the bytes in `data`.
+  std::string hash(std::span<const uint8_t> data) const {
+    return hash(data.data(), data.size());
+  }
+#endif
 
-    for (int i = 0; i < 80; i++) {
-      uint64_t T1 =
-          h + big_sigma_1(e) + ch<uint64_t>(e, f, g) + SHA512_K[i] + words[i];
-      uint64_t T2 = big_sigma_0(a) + maj<uint64_t>(a, b, c);
-      h = g;
-      g = f;
-      f = e;
-      e = d + T1;
-      d = c;
-      c = b;
-      b = a;
-      a = T1 + T2;
+  // Computes the raw digest of `len` bytes of binary input data. No context
+  // is set up: short messages are padded on the stack and compressed in one
+  // call, see Engine::hash_message.
+  Digest digest(const uint8_t* data, size_t len) const {
+    SHA_STATS_ALGORITHM(algorithm());
+    Word hash_values[8];
+    Engine::hash_message(data, len, Traits::initial_hash(), hash_values);
+    return to_digest<DIGEST_SIZE>(hash_values);
+  }
+
+  // Computes the raw digest of the NUL-terminated input string.
+  Digest digest(const char* data) const {
+    return digest(reinterpret_cast<const uint8_t*>(data), strlen(data));
+  }
+
+  // Computes the raw digest of the input string, including any embedded NUL
+  // bytes.
+  Digest digest(const std::string& data) const {
+    return digest(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+  }
+
+#ifdef SHA_HAS_STRING_VIEW
+  // Computes the raw digest of the bytes viewed by `data`. The function is
+  // constexpr, so the digest of a constant string can be computed at compile
+  // time.
+  static constexpr Digest digest(std::string_view data) {
+#ifdef SHA_HAS_IS_CONSTANT_EVALUATED
+    if (!__builtin_is_constant_evaluated()) {
+      const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+      return SHA2().digest(bytes, data.size());
     }
+#endif
+    return detail::constexpr_digest<DIGEST_SIZE>(data,
+                                                 Traits::initial_hash());
+  }
+#endif
 
-    hash_values[0] += a;
-    hash_values[1] += b;
-    hash_values[2] += c;
-    hash_values[3] += d;
-    hash_values[4] += e;
-    hash_values[5] += f;
-    hash_values[6] += g;
-    hash_values[7] += h;
+#ifdef SHA_HAS_SPAN
+  // Computes the raw digest of the bytes in `data`.
+  Digest digest(std::span<const uint8_t> data) const {
+    return digest(data.data(), data.size());
   }
+#endif
 
-  // Applies the big sigma_0 transformation for SHA-512.
-  constexpr uint64_t big_sigma_0(uint64_t x) const {
-    return RotR<uint64_t>(x, 28) ^ RotR<uint64_t>(x, 34) ^
-           RotR<uint64_t>(x, 39);
+  // Returns whether the digest of `len` bytes of binary input data is
+  // `expected`. The digests are compared in constant time.
+  bool verify(const uint8_t* data, size_t len, const Digest& expected) const {
+    Digest actual = digest(data, len);
+    return constant_time_equal(actual.data(), expected.data(), DIGEST_SIZE);
   }
 
-  // Applies the big sigma_1 transformation for SHA-512.
-  constexpr uint64_t big_sigma_1(uint64_t x) const {
-    return RotR<uint64_t>(x, 14) ^ RotR<uint64_t>(x, 18) ^
-           RotR<uint64_t>(x, 41);
+  // Returns whether the digest of `len` bytes of binary input data is the
+  // hexadecimal digest `hex`, in either case. The expected digest is decoded
+  // once and compared in binary; a `hex` that is not HEX_SIZE hexadecimal
+  // digits fails before any data is hashed.
+  bool verify(const uint8_t* data, size_t len, const std::string& hex) const {
+    Digest expected;
+    if (hex.size() != HEX_SIZE ||
+        !hex_decode(hex.data(), hex.size(), expected.data())) {
+      return false;
+    }
+    return verify(data, len, expected);
   }
 
-  // Applies the small sigma_0 transformation for SHA-512.
-  constexpr uint64_t small_sigma_0(uint64_t x) const {
-    return RotR<uint64_t>(x, 1) ^ RotR<uint64_t>(x, 8) ^ ShR<uint64_t>(x, 7);
+  // Returns whether the digest of the bytes of `data` is `expected`.
+  bool verify(const std::string& data, const Digest& expected) const {
+    return verify(reinterpret_cast<const uint8_t*>(data.data()), data.size(),
+                  expected);
   }
 
-  // Applies the small sigma_1 transformation for SHA-512.
-  constexpr uint64_t small_sigma_1(uint64_t x) const {
-    return RotR<uint64_t>(x, 19) ^ RotR<uint64_t>(x, 61) ^ ShR<uint64_t>(x, 6);
+  // Returns whether the digest of the bytes of `data` is the hexadecimal
+  // digest `hex`.
+  bool verify(const std::string& data, const std::string& hex) const {
+    return verify(reinterpret_cast<const uint8_t*>(data.data()), data.size(),
+                  hex);
   }
 
- protected:
-  // Hashes the input data using an initial hash value and returns the result as
-  // a hexadecimal string.
-  std::string __hash(const char* data, const uint64_t* init_hash) const {
-    uint64_t hash_vals[8];
-    std::memcpy(hash_vals, init_hash, 64);
+  // Computes the raw digest of the concatenation of the `count` segments at
+  // `segments`, e.g. the header, body fragments and trailer of a frame,
+  // without first joining them.
+  Digest digest_segments(const Segment* segments, size_t count) const {
+    return digest_each(segments, count);
+  }
+
+  // Computes the hash of the concatenation of the `count` segments at
+  // `segments` in hexadecimal.
+  std::string hash_segments(const Segment* segments, size_t count) const {
+    SHA_STATS_ALGORITHM(algorithm());
+    return to_hex(digest_each(segments, count));
+  }
 
-    std::string preprocessed_data = prepare_input(data);
-    std::vector<uint64_t> data_in_uint64_t =
-        to_integral_vector<uint64_t>(preprocessed_data);
+#ifdef SHA_HAS_IOVEC
+  // Computes the raw digest of the concatenation of the `count` buffers of a
+  // scatter/gather array.
+  Digest digest_segments(const struct iovec* iov, size_t count) const {
+    return digest_each(iov, count);
+  }
+
+  // Computes the hash of the concatenation of the `count` buffers of a
+  // scatter/gather array in hexadecimal.
+  std::string hash_segments(const struct iovec* iov, size_t count) const {
+    SHA_STATS_ALGORITHM(algorithm());
+    return to_hex(digest_each(iov, count));
+  }
+#endif
 
-    size_t N = preprocessed_data.size() / 128;
-    for (int block = 0; block < N; block++) {
-      process_block(data_in_uint64_t, block, hash_vals);
+  // Computes the raw digests of `count` independent messages and stores them
+  // in `out`, which may point to Digest or AnyDigest values, hashing several
+  // messages in parallel with the multi-buffer backend.
+  template <typename Output>
+  static void hash_many(const Segment* inputs, size_t count, Output* out) {
+    SHA_STATS_ALGORITHM(algorithm());
+    Engine::template hash_many<DIGEST_SIZE>(inputs, count, out,
+                                            Traits::initial_hash());
+  }
+
+#ifdef SHA_HAS_SPAN
+  // Computes the raw digests of `inputs` and stores them in `out`, which must
+  // hold at least inputs.size() digests.
+  static void hash_many(std::span<const std::span<const uint8_t>> inputs,
+                        std::span<Digest> out) {
+    SHA_STATS_ALGORITHM(algorithm());
+    Engine::template hash_many<DIGEST_SIZE>(inputs.data(), inputs.size(),
+                                            out.data(),
+                                            Traits::initial_hash());
+  }
+#endif
+
+  // Computes the raw digest of the 32 bytes at `data`, e.g. a digest being
+  // hashed again. Like the other fixed-size entry points below, it sets up
+  // no context. With the scalar backends, the part of the schedule that the
+  // padding determines is taken from a table computed once.
+  static Digest digest32(const uint8_t* data) {
+    SHA_STATS_ALGORITHM(algorithm());
+    Word hash_values[8];
+    Engine::template hash_fixed<32>(data, Traits::initial_hash(), hash_values);
+    return to_digest<DIGEST_SIZE>(hash_values);
+  }
+
+  // Computes the raw digest of the 64 bytes at `data`, e.g. the two child
+  // digests of a Merkle node. For SHA-256 and SHA-224 the message fills a
+  // block, and the padding block after it is compressed from a schedule
+  // expanded once, except by the hardware backends.
+  static Digest digest64(const uint8_t* data) {
+    SHA_STATS_ALGORITHM(algorithm());
+    Word hash_values[8];
+    Engine::template hash_fixed<64>(data, Traits::initial_hash(), hash_values);
+    return to_digest<DIGEST_SIZE>(hash_values);
+  }
+
+  // Computes the raw digest of the `Len` bytes at `data`, for inputs of
+  // other fixed sizes, e.g. a prefixed Merkle node of 1 + 2 * DIGEST_SIZE
+  // bytes.
+  template <size_t Len>
+  static Digest digest_fixed(const uint8_t* data) {
+    SHA_STATS_ALGORITHM(algorithm());
+    Word hash_values[8];
+    Engine::template hash_fixed<Len>(data, Traits::initial_hash(),
+                                     hash_values);
+    return to_digest<DIGEST_SIZE>(hash_values);
+  }
+
+  // Computes the digest of the raw digest of `len` bytes of binary input
+  // data, e.g. SHA-256d of a block header. The second hash takes the
+  // fixed-size path.
+  static Digest digest_double(const uint8_t* data, size_t len) {
+    SHA_STATS_ALGORITHM(algorithm());
+    Word hash_values[8];
+    Engine::hash_message(data, len, Traits::initial_hash(), hash_values);
+    Digest inner = to_digest<DIGEST_SIZE>(hash_values);
+    Engine::template hash_fixed<DIGEST_SIZE>(inner.data(),
+                                             Traits::initial_hash(),
+                                             hash_values);
+    return to_digest<DIGEST_SIZE>(hash_values);
+  }
+
+  // Computes the raw digests of the `count` 32-byte messages stored back to
+  // back at `inputs` and stores them in `out`, which may point to Digest or
+  // AnyDigest values, hashing several messages in parallel with the
+  // multi-buffer backend. The lanes pad each message at run time. Digests no
+  // larger than 32 bytes may overwrite their messages, with `out` pointing to
+  // `inputs`; otherwise the two ranges must not overlap.
+  template <typename Output>
+  static void digest32_many(const uint8_t* inputs, size_t count,
+                            Output* out) {
+    SHA_STATS_ALGORITHM(algorithm());
+    Engine::template hash_fixed_many<32, DIGEST_SIZE>(inputs, count, out,
+                                                      Traits::initial_hash());
+  }
+
+  // Computes the raw digests of the `count` 64-byte messages stored back to
+  // back at `inputs`, e.g. the concatenated child digests of one level of a
+  // Merkle tree, and stores them in `out`. For SHA-256 and SHA-224 all lanes
+  // share one padding block, compressed from its precomputed schedule.
+  // Digest outputs may overwrite their messages, with `out` pointing to
+  // `inputs`; AnyDigest outputs are larger and must not overlap them.
+  template <typename Output>
+  static void digest64_many(const uint8_t* inputs, size_t count,
+                            Output* out) {
+    SHA_STATS_ALGORITHM(algorithm());
+    Engine::template hash_fixed_many<64, DIGEST_SIZE>(inputs, count, out,
+                                                      Traits::initial_hash());
+  }
+
+  // Computes the raw digests of the `count` messages of `Len` bytes stored
+  // back to back at `inputs` and stores them in `out`. The messages need no
+  // segment list and are not sorted, since they all have the same length.
+  // `out` may point to `inputs` if an Output is no larger than `Len`
+  // bytes; otherwise the two ranges must not overlap.
+  template <size_t Len, typename Output>
+  static void digest_fixed_many(const uint8_t* inputs, size_t count,
+                                Output* out) {
+    SHA_STATS_ALGORITHM(algorithm());
+    Engine::template hash_fixed_many<Len, DIGEST_SIZE>(inputs, count, out,
+                                                       Traits::initial_hash());
+  }
+
+  // Computes digest_double() of `count` independent messages and stores the
+  // results in `out`. Both rounds of hashing use the multi-buffer backend.
+  static void digest_double_many(const Segment* inputs, size_t count,
+                                 Digest* out) {
+    static_assert(sizeof(Digest) == DIGEST_SIZE, "Digest must be packed");
+    SHA_STATS_ALGORITHM(algorithm());
+    Engine::template hash_many<DIGEST_SIZE>(inputs, count, out,
+                                            Traits::initial_hash());
+    // The inner digests lie back to back in `out` and are hashed in place.
+    Engine::template hash_fixed_many<DIGEST_SIZE, DIGEST_SIZE>(
+        reinterpret_cast<const uint8_t*>(out), count, out,
+        Traits::initial_hash());
+  }
+
+ private:
+  // Feeds the `count` segments at `inputs` into the context in order.
+  template <typename Input>
+  void update_each(const Input* inputs, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      Segment input = detail::as_segment(inputs[i]);
+      update(input.data, input.size);
     }
-    std::string hashed_value = to_string(hash_vals);
-    return to_hex(hashed_value);
   }
 
- public:
-  // Computes a SHA-512 hash from input data.
-  std::string hash(const char* data) const {
-    return __hash(data, CONST_SHA512_H);
+  // Computes the raw digest of the concatenation of the `count` segments at
+  // `inputs`. A message short enough for Engine::hash_message is gathered on
+  // the stack; a longer one is streamed through a context.
+  template <typename Input>
+  static Digest digest_each(const Input* inputs, size_t count) {
+    SHA_STATS_ALGORITHM(algorithm());
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+      total += detail::as_segment(inputs[i]).size;
+    }
+    if (total > Engine::MAX_SHORT_MESSAGE) {
+      SHA2 context;
+      context.update_each(inputs, count);
+      return context.finalize_digest();
+    }
+    uint8_t message[Engine::MAX_SHORT_MESSAGE];
+    size_t offset = 0;
+    for (size_t i = 0; i < count; i++) {
+      Segment input = detail::as_segment(inputs[i]);
+      if (input.size != 0) {
+        std::memcpy(message + offset, input.data, input.size);
+        offset += input.size;
+      }
+    }
+    Word hash_values[8];
+    Engine::hash_message(message, total, Traits::initial_hash(), hash_values);
+    return to_digest<DIGEST_SIZE>(hash_values);
   }
 };
 
-class SHA384 : public SHA512 {
- public:
-  // Computes a SHA-384 hash from input data.
-  std::string hash(const char* data) const {
-    std::string hash_digest = __hash(data, CONST_SHA384_H);
-    hash_digest.resize(96);
-    return hash_digest;
+typedef SHA2<SHA256Traits> SHA256;
+typedef SHA2<SHA224Traits> SHA224;
+typedef SHA2<SHA512Traits> SHA512;
+typedef SHA2<SHA384Traits> SHA384;
+typedef SHA2<SHA512_224Traits> SHA512_224;
+typedef SHA2<SHA512_256Traits> SHA512_256;
+
+// Returns the digest size in bytes of `algorithm`.
+inline size_t digest_size(Algorithm algorithm) {
+  switch (algorithm) {
+    case Algorithm::SHA224:
+    case Algorithm::SHA512_224:
+      return 28;
+    case Algorithm::SHA256:
+    case Algorithm::SHA512_256:
+      return 32;
+    case Algorithm::SHA384:
+      return 48;
+    case Algorithm::SHA512:
+      return 64;
   }
-};
+  return 0;
+}
 
-class SHA512_224 : public SHA512 {
- public:
-  // Computes a SHA-512/224 hash from input data and returns it as a
-  // 56-character string.
-  std::string hash(const char* data) const {
-    std::string hash_digest = __hash(data, CONST_SHA512_224_H);
-    hash_digest.resize(56);
-    return hash_digest;
+// Returns the conventional name of `algorithm`, e.g. "SHA-256".
+inline const char* algorithm_name(Algorithm algorithm) {
+  switch (algorithm) {
+    case Algorithm::SHA224:
+      return "SHA-224";
+    case Algorithm::SHA256:
+      return "SHA-256";
+    case Algorithm::SHA384:
+      return "SHA-384";
+    case Algorithm::SHA512:
+      return "SHA-512";
+    case Algorithm::SHA512_224:
+      return "SHA-512/224";
+    case Algorithm::SHA512_256:
+      return "SHA-512/256";
   }
-};
+  return "";
+}
+
+// Computes the raw `algorithm` digest of `len` bytes at `data`.
+inline AnyDigest digest(Algorithm algorithm, const void* data, size_t len) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  switch (algorithm) {
+    case Algorithm::SHA224:
+      return SHA224().digest(bytes, len);
+    case Algorithm::SHA256:
+      return SHA256().digest(bytes, len);
+    case Algorithm::SHA384:
+      return SHA384().digest(bytes, len);
+    case Algorithm::SHA512:
+      return SHA512().digest(bytes, len);
+    case Algorithm::SHA512_224:
+      return SHA512_224().digest(bytes, len);
+    case Algorithm::SHA512_256:
+      return SHA512_256().digest(bytes, len);
+  }
+  return AnyDigest();
+}
+
+// Computes the raw `algorithm` digests of `count` independent messages with
+// the algorithm's hash_many and stores them in `out`.
+inline void hash_many(Algorithm algorithm, const Segment* inputs, size_t count,
+                      AnyDigest* out) {
+  switch (algorithm) {
+    case Algorithm::SHA224:
+      return SHA224::hash_many(inputs, count, out);
+    case Algorithm::SHA256:
+      return SHA256::hash_many(inputs, count, out);
+    case Algorithm::SHA384:
+      return SHA384::hash_many(inputs, count, out);
+    case Algorithm::SHA512:
+      return SHA512::hash_many(inputs, count, out);
+    case Algorithm::SHA512_224:
+      return SHA512_224::hash_many(inputs, count, out);
+    case Algorithm::SHA512_256:
+      return SHA512_256::hash_many(inputs, count, out);
+  }
+}
 
-class SHA512_256 : public SHA512 {
+// A streaming context for an algorithm chosen at run time. It has the same
+// init/update/finalize interface as the fixed-algorithm classes and, like
+// them, can be copied to snapshot a partial computation.
+class Hasher {
  public:
-  // Computes a SHA-512/256 hash from input data.
-  std::string hash(const char* data) const {
-    std::string hash_digest = __hash(data, CONST_SHA512_256_H);
-    hash_digest.resize(64);
-    return hash_digest;
+  explicit Hasher(Algorithm algorithm) : algo(algorithm) {
+    switch (algo) {
+      case Algorithm::SHA224:
+        new (&sha224) SHA224();
+        break;
+      case Algorithm::SHA256:
+        new (&sha256) SHA256();
+        break;
+      case Algorithm::SHA384:
+        new (&sha384) SHA384();
+        break;
+      case Algorithm::SHA512:
+        new (&sha512) SHA512();
+        break;
+      case Algorithm::SHA512_224:
+        new (&sha512_224) SHA512_224();
+        break;
+      case Algorithm::SHA512_256:
+        new (&sha512_256) SHA512_256();
+        break;
+    }
+  }
+
+  // Returns the algorithm computed by this context.
+  Algorithm algorithm() const { return algo; }
+
+  // Returns the digest size in bytes of the algorithm.
+  size_t digest_size() const { return sha::digest_size(algo); }
+
+  // Resets the context to start a new message.
+  void init() {
+    switch (algo) {
+      case Algorithm::SHA224:
+        return sha224.init();
+      case Algorithm::SHA256:
+        return sha256.init();
+      case Algorithm::SHA384:
+        return sha384.init();
+      case Algorithm::SHA512:
+        return sha512.init();
+      case Algorithm::SHA512_224:
+        return sha512_224.init();
+      case Algorithm::SHA512_256:
+        return sha512_256.init();
+    }
+  }
+
+  // Appends `len` bytes at `data` to the message.
+  void update(const void* data, size_t len) {
+    switch (algo) {
+      case Algorithm::SHA224:
+        return sha224.update(data, len);
+      case Algorithm::SHA256:
+        return sha256.update(data, len);
+      case Algorithm::SHA384:
+        return sha384.update(data, len);
+      case Algorithm::SHA512:
+        return sha512.update(data, len);
+      case Algorithm::SHA512_224:
+        return sha512_224.update(data, len);
+      case Algorithm::SHA512_256:
+        return sha512_256.update(data, len);
+    }
+  }
+
+  // Appends the `count` segments at `segments` to the message in order.
+  void update_segments(const Segment* segments, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      update(segments[i].data, segments[i].size);
+    }
+  }
+
+#ifdef SHA_HAS_IOVEC
+  // Appends the `count` buffers of a scatter/gather array to the message in
+  // order.
+  void update_segments(const struct iovec* iov, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      update(iov[i].iov_base, iov[i].iov_len);
+    }
   }
+#endif
+
+  // Completes the message and returns its raw digest. The context is reset
+  // afterwards, so the next update() starts a new message.
+  AnyDigest finalize_digest() {
+    switch (algo) {
+      case Algorithm::SHA224:
+        return sha224.finalize_digest();
+      case Algorithm::SHA256:
+        return sha256.finalize_digest();
+      case Algorithm::SHA384:
+        return sha384.finalize_digest();
+      case Algorithm::SHA512:
+        return sha512.finalize_digest();
+      case Algorithm::SHA512_224:
+        return sha512_224.finalize_digest();
+      case Algorithm::SHA512_256:
+        return sha512_256.finalize_digest();
+    }
+    return AnyDigest();
+  }
+
+  // Completes the message and returns its digest in hexadecimal.
+  std::string finalize() { return finalize_digest().hex(); }
+
+  // Completes the message, writes its digest in hexadecimal to `out`, which
+  // must have room for 2 * digest_size() characters, and returns the number
+  // of characters written. No terminating NUL is written.
+  size_t finalize(char* out) { return finalize_digest().hex(out); }
+
+ private:
+  Algorithm algo;
+  // The contexts are trivially copyable and destructible, so the union needs
+  // no special members beyond the constructor above.
+  union {
+    SHA224 sha224;
+    SHA256 sha256;
+    SHA384 sha384;
+    SHA512 sha512;
+    SHA512_224 sha512_224;
+    SHA512_256 sha512_256;
+  };
 };
 }  // namespace sha
 
@@ -0,0 +1,161 @@
+/*
+ * sha_batch.h
+ *
+ * This header file defines sha::BatchHasher, which hashes large batches of
+ * independent messages in parallel. The messages of a batch are spread over a
+ * work-stealing sha::ThreadPool and each worker hashes its share with the
+ * multi-buffer hash_many of the chosen algorithm. Digests are returned in
+ * input order.
+ */
+
+#ifndef SHA_BATCH_H_
+#define SHA_BATCH_H_
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "sha.h"
+#include "sha_thread_pool.h"
+
+namespace sha {
+
+namespace detail {
+
+// Upper bound on the messages of a chunk, so that batches of tiny messages
+// are still cut into enough chunks to balance.
+static const size_t MAX_CHUNK_MESSAGES = 1024;
+
+// Lower bound on the bytes of a chunk, so that the scheduling overhead stays
+// small compared to the hashing work.
+static const size_t MIN_CHUNK_BYTES = 64 * 1024;
+
+// The number of chunks each worker should get on average; more chunks give
+// the stealing workers finer pieces to balance with.
+static const size_t CHUNKS_PER_WORKER = 16;
+
+// Cuts a batch of `count` messages, where size_of(i) returns the size of
+// message i, into chunks of consecutive messages that hold roughly equal
+// numbers of bytes for `workers` workers. Stores the first message of each
+// chunk in `starts`, followed by `count`.
+template <typename SizeOf>
+void plan_chunks(size_t count, size_t workers, SizeOf size_of,
+                 std::vector<size_t>& starts) {
+  size_t total_bytes = 0;
+  for (size_t i = 0; i < count; i++) {
+    total_bytes += size_of(i);
+  }
+  size_t chunk_bytes = total_bytes / (workers * CHUNKS_PER_WORKER);
+  if (chunk_bytes < MIN_CHUNK_BYTES) {
+    chunk_bytes = MIN_CHUNK_BYTES;
+  }
+
+  starts.assign(1, 0);
+  size_t bytes = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (bytes >= chunk_bytes || i - starts.back() == MAX_CHUNK_MESSAGES) {
+      starts.push_back(i);
+      bytes = 0;
+    }
+    bytes += size_of(i);
+  }
+  starts.push_back(count);
+}
+}  // namespace detail
+
+// Hashes batches of independent messages with one algorithm on a pool of
+// worker threads. A batch is cut into chunks of consecutive messages that
+// hold roughly equal numbers of bytes; the workers of the pool take chunks,
+// stealing from each other when their own run out, and write each chunk's
+// digests to the matching positions of the output.
+class BatchHasher {
+ public:
+  // Creates a hasher for `algorithm` with a pool of `threads` workers,
+  // including the calling thread. Zero selects one per hardware thread.
+  explicit BatchHasher(Algorithm algorithm, size_t threads = 0)
+      : algo(algorithm), pool(threads), scratch(pool.size()) {}
+
+  // Returns the algorithm the hasher computes.
+  Algorithm algorithm() const { return algo; }
+
+  // Returns the number of workers hashing each batch.
+  size_t threads() const { return pool.size(); }
+
+  // Computes the digests of `count` messages and stores them in `out`, in the
+  // order of `inputs`.
+  void hash(const Segment* inputs, size_t count, AnyDigest* out) {
+    hash_batch(inputs, count, out);
+  }
+
+  // Computes the digests of `inputs` and returns them in input order.
+  std::vector<AnyDigest> hash(const std::vector<Segment>& inputs) {
+    std::vector<AnyDigest> digests(inputs.size());
+    hash_batch(inputs.data(), inputs.size(), digests.data());
+    return digests;
+  }
+
+  // Computes the digests of `inputs` and returns them in input order.
+  std::vector<AnyDigest> hash(const std::vector<std::string>& inputs) {
+    std::vector<AnyDigest> digests(inputs.size());
+    hash_batch(inputs.data(), inputs.size(), digests.data());
+    return digests;
+  }
+
+ private:
+  // Per-worker buffers reused from chunk to chunk and batch to batch.
+  struct Scratch {
+    std::vector<Segment> segments;
+  };
+
+  // Returns the inputs of a chunk as Segments: Segment inputs are used in
+  // place, others are converted into the worker's scratch buffer.
+  static const Segment* chunk_segments(const Segment* inputs, size_t count,
+                                       Scratch& scratch) {
+    (void)count;
+    (void)scratch;
+    return inputs;
+  }
+  template <typename Input>
+  static const Segment* chunk_segments(const Input* inputs, size_t count,
+                                       Scratch& scratch) {
+    scratch.segments.resize(count);
+    for (size_t i = 0; i < count; i++) {
+      scratch.segments[i] = detail::as_segment(inputs[i]);
+    }
+    return scratch.segments.data();
+  }
+
+  // Cuts the batch into chunks by byte volume, then hashes the chunks on the
+  // pool.
+  template <typename Input>
+  void hash_batch(const Input* inputs, size_t count, AnyDigest* out) {
+    if (count == 0) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(batch_mutex);
+    detail::plan_chunks(
+        count, pool.size(),
+        [inputs](size_t i) { return detail::as_segment(inputs[i]).size; },
+        chunk_starts);
+
+    const Algorithm algorithm = algo;
+    pool.run(chunk_starts.size() - 1, [&](size_t worker, size_t chunk) {
+      const size_t begin = chunk_starts[chunk];
+      const size_t size = chunk_starts[chunk + 1] - begin;
+      const Segment* segments =
+          chunk_segments(inputs + begin, size, scratch[worker]);
+      hash_many(algorithm, segments, size, out + begin);
+    });
+  }
+
+  Algorithm algo;
+  ThreadPool pool;
+  std::vector<Scratch> scratch;
+
+  // Guards chunk_starts and scratch, which are reused by every batch.
+  std::mutex batch_mutex;
+  std::vector<size_t> chunk_starts;
+};
+}  // namespace sha
+
+#endif  // SHA_BATCH_H_
@@ -0,0 +1,246 @@
+/*
+ * sha_cache.h
+ *
+ * This header file defines sha::CachingHasher, a memoizing wrapper around the
+ * one-shot digest of a SHA-2 class for workloads that hash the same inputs
+ * over and over. Digests are kept in a byte-bounded LRU cache that is split
+ * into independently locked shards. Entries are found by a cheap
+ * non-cryptographic fingerprint of the content and its length, and a hit is
+ * only served after the full content has been compared, so a fingerprint
+ * collision costs a compression but never returns a wrong digest.
+ */
+
+#ifndef SHA_CACHE_H_
+#define SHA_CACHE_H_
+
+#include <cstring>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "sha.h"
+
+namespace sha {
+
+namespace detail {
+
+// Returns a 64-bit non-cryptographic fingerprint of the `len` bytes at
+// `data`. Four independent lanes each mix eight bytes at a time, so the
+// multiplications overlap and the fingerprint costs far less than a
+// compression. It only finds candidate cache entries, never decides equality.
+inline uint64_t fingerprint(const void* data, size_t len) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  const uint64_t MULTIPLIER = 0x9e3779b97f4a7c15;
+  uint64_t lanes[4] = {len, len ^ 0x243f6a8885a308d3, len ^ 0x13198a2e03707344,
+                       len ^ 0xa4093822299f31d0};
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    for (int lane = 0; lane < 4; lane++) {
+      uint64_t word;
+      std::memcpy(&word, bytes + i + lane * 8, 8);
+      lanes[lane] = (lanes[lane] ^ word) * MULTIPLIER;
+      lanes[lane] ^= lanes[lane] >> 29;
+    }
+  }
+  uint64_t h = lanes[0] ^ (lanes[1] * 3) ^ (lanes[2] * 5) ^ (lanes[3] * 7);
+  for (; i + 8 <= len; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, bytes + i, 8);
+    h = (h ^ word) * MULTIPLIER;
+    h ^= h >> 29;
+  }
+  if (i < len) {
+    uint64_t word = 0;
+    std::memcpy(&word, bytes + i, len - i);
+    h = (h ^ word) * MULTIPLIER;
+  }
+  h ^= h >> 32;
+  h *= 0xd6e8feb86659fd93;
+  return h ^ (h >> 32);
+}
+}  // namespace detail
+
+// Counters of a CachingHasher, summed over its shards.
+struct CacheStats {
+  uint64_t hits;       // Digests served from the cache.
+  uint64_t misses;     // Digests computed, whether or not they were cached.
+  uint64_t evictions;  // Entries dropped to stay within the byte budget.
+  size_t entries;      // Entries currently cached.
+  size_t bytes;        // Bytes currently charged against the budget.
+};
+
+// Computes digests with the SHA-2 class `Hasher`, e.g. CachingHasher<SHA256>,
+// remembering the digests of recent inputs. Each entry stores a copy of its
+// input and is charged its size plus ENTRY_OVERHEAD bytes; each shard evicts
+// its least recently used entries once it exceeds its share of the budget.
+// Inputs larger than a shard's share are hashed without being cached. All
+// member functions are thread-safe.
+template <typename Hasher>
+class CachingHasher {
+ public:
+  typedef typename Hasher::Digest Digest;
+
+  // The default number of shards; threads only contend when they hit the
+  // same shard.
+  static const size_t DEFAULT_SHARDS = 16;
+
+  // The bytes charged per entry on top of its input, approximating the list
+  // node, the index node and the heap block of the copy.
+  static const size_t ENTRY_OVERHEAD = 128;
+
+  // Creates a cache holding at most `max_bytes` bytes in `shards` shards.
+  // Throws std::invalid_argument if `shards` is zero.
+  explicit CachingHasher(size_t max_bytes, size_t shards = DEFAULT_SHARDS)
+      : budget(max_bytes), shard_list(shards) {
+    if (shards == 0) {
+      throw std::invalid_argument("sha::CachingHasher: shards must be > 0");
+    }
+    for (Shard& shard : shard_list) {
+      shard.budget = max_bytes / shards;
+    }
+  }
+
+  // Returns the byte budget of the cache.
+  size_t max_bytes() const { return budget; }
+
+  // Returns the raw digest of the `len` bytes at `data`, from the cache if
+  // the same bytes were hashed recently.
+  Digest digest(const void* data, size_t len) {
+    uint64_t key = detail::fingerprint(data, len);
+    Shard& shard = shard_list[(key >> 32) % shard_list.size()];
+    Digest digest;
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      if (shard.lookup(key, data, len, &digest)) {
+        shard.hits++;
+        return digest;
+      }
+      shard.misses++;
+    }
+    // Hash without holding the lock, so a miss never blocks other threads
+    // of the shard on a compression.
+    digest = Hasher().digest(static_cast<const uint8_t*>(data), len);
+    if (len + ENTRY_OVERHEAD <= shard.budget) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      Digest cached;
+      if (!shard.lookup(key, data, len, &cached)) {
+        shard.insert(key, data, len, digest);
+      }
+    }
+    return digest;
+  }
+
+  // Returns the raw digest of the bytes of `data`.
+  Digest digest(const std::string& data) {
+    return digest(data.data(), data.size());
+  }
+
+  // Returns the digest of the `len` bytes at `data` in hexadecimal.
+  std::string hash(const void* data, size_t len) {
+    return AnyDigest(digest(data, len)).hex();
+  }
+
+  // Returns the digest of the bytes of `data` in hexadecimal.
+  std::string hash(const std::string& data) {
+    return hash(data.data(), data.size());
+  }
+
+  // Returns the counters and the current size of the cache.
+  CacheStats stats() const {
+    CacheStats total = {0, 0, 0, 0, 0};
+    for (const Shard& shard : shard_list) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      total.hits += shard.hits;
+      total.misses += shard.misses;
+      total.evictions += shard.evictions;
+      total.entries += shard.entries.size();
+      total.bytes += shard.bytes;
+    }
+    return total;
+  }
+
+  // Drops every entry. The counters are kept.
+  void clear() {
+    for (Shard& shard : shard_list) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.index.clear();
+      shard.entries.clear();
+      shard.bytes = 0;
+    }
+  }
+
+ private:
+  struct Entry {
+    uint64_t key;
+    std::string content;
+    Digest digest;
+  };
+  typedef typename std::list<Entry>::iterator Position;
+
+  // One lock stripe of the cache: its entries in LRU order, most recently
+  // used first, and an index from fingerprint to entry. Different inputs
+  // with the same fingerprint share an index key.
+  struct Shard {
+    Shard() : budget(0), bytes(0), hits(0), misses(0), evictions(0) {}
+
+    // Finds the entry holding exactly the `len` bytes at `data`, moves it to
+    // the front and stores its digest in `digest`.
+    bool lookup(uint64_t key, const void* data, size_t len, Digest* digest) {
+      auto range = index.equal_range(key);
+      for (auto it = range.first; it != range.second; ++it) {
+        const std::string& content = it->second->content;
+        if (content.size() == len &&
+            (len == 0 || std::memcmp(content.data(), data, len) == 0)) {
+          entries.splice(entries.begin(), entries, it->second);
+          *digest = it->second->digest;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    // Adds an entry at the front and evicts from the back until the shard
+    // fits its budget again.
+    void insert(uint64_t key, const void* data, size_t len,
+                const Digest& digest) {
+      Entry entry = {key, std::string(static_cast<const char*>(data), len),
+                     digest};
+      entries.push_front(std::move(entry));
+      index.insert(std::make_pair(key, entries.begin()));
+      bytes += len + ENTRY_OVERHEAD;
+      while (bytes > budget) {
+        Position last = std::prev(entries.end());
+        auto range = index.equal_range(last->key);
+        for (auto it = range.first; it != range.second; ++it) {
+          if (it->second == last) {
+            index.erase(it);
+            break;
+          }
+        }
+        bytes -= last->content.size() + ENTRY_OVERHEAD;
+        entries.erase(last);
+        evictions++;
+      }
+    }
+
+    mutable std::mutex mutex;
+    std::list<Entry> entries;
+    std::unordered_multimap<uint64_t, Position> index;
+    size_t budget;
+    size_t bytes;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+  };
+
+  size_t budget;
+  std::vector<Shard> shard_list;
+};
+}  // namespace sha
+
+#endif  // SHA_CACHE_H_
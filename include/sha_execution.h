@@ -0,0 +1,143 @@
+/*
+ * sha_execution.h
+ *
+ * This header file defines sha::hash_all, which hashes a range of independent
+ * messages, e.g. a std::vector<std::string>, under a C++17 execution policy.
+ * The parallel policies cut the range by byte volume, as sha::BatchHasher
+ * does, and hash the pieces on a work-stealing sha::ThreadPool shared by all
+ * calls; each worker hashes its pieces with the multi-buffer hash_many.
+ *
+ * The header needs C++17 and a standard library that provides the execution
+ * policies, and is empty otherwise. With libstdc++, <execution> refers to
+ * Intel TBB whenever its headers are installed, so unoptimized builds may
+ * have to be linked with -ltbb, although hash_all runs no standard parallel
+ * algorithm itself.
+ */
+
+#ifndef SHA_EXECUTION_H_
+#define SHA_EXECUTION_H_
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<execution>)
+#include <execution>
+#endif
+#endif
+
+#ifdef __cpp_lib_execution
+#define SHA_HAS_EXECUTION 1
+
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#include "sha.h"
+#include "sha_batch.h"
+#include "sha_thread_pool.h"
+
+namespace sha {
+
+namespace detail {
+
+// Returns the pool that runs the parallel hash_all() calls, with one worker
+// per hardware thread. It is created by the first parallel call.
+inline ThreadPool& execution_pool() {
+  static ThreadPool pool;
+  return pool;
+}
+
+// Whether the execution policy `Policy` lets hash_all() use several threads.
+template <typename Policy>
+struct is_parallel_policy : std::false_type {};
+template <>
+struct is_parallel_policy<std::execution::parallel_policy> : std::true_type {};
+template <>
+struct is_parallel_policy<std::execution::parallel_unsequenced_policy>
+    : std::true_type {};
+}  // namespace detail
+
+// Computes the raw digests of the messages in [first, last) with the SHA-2
+// class `Hasher` and writes them, in input order, to the range that starts at
+// `out`, e.g.
+//
+//   sha::hash_all<sha::SHA256>(std::execution::par, payloads.begin(),
+//                              payloads.end(), digests.begin());
+//
+// The messages may be Segment, std::string, std::string_view or std::span
+// values, and the digests Hasher::Digest or AnyDigest values. Both ranges need
+// random access iterators.
+//
+// Under std::execution::par and par_unseq, the range is cut into chunks of
+// consecutive messages with roughly equal numbers of bytes, so a few large
+// messages do not leave the other threads idle, and the chunks are hashed on
+// a shared thread pool. Parallel calls from several threads take turns on the
+// pool. Other policies hash the chunks on the calling thread. Either way each
+// chunk goes through hash_many, whose multi-buffer lanes take the runs of
+// small messages.
+template <typename Hasher, typename ExecutionPolicy, typename InputIt,
+          typename OutputIt>
+typename std::enable_if<std::is_execution_policy<
+    typename std::decay<ExecutionPolicy>::type>::value>::type
+hash_all(ExecutionPolicy&&, InputIt first, InputIt last, OutputIt out) {
+  static_assert(
+      std::is_base_of<std::random_access_iterator_tag,
+                      typename std::iterator_traits<
+                          InputIt>::iterator_category>::value,
+      "sha::hash_all needs random access input iterators");
+  static_assert(
+      std::is_base_of<std::random_access_iterator_tag,
+                      typename std::iterator_traits<
+                          OutputIt>::iterator_category>::value,
+      "sha::hash_all needs random access output iterators");
+  typedef typename Hasher::Digest Digest;
+  const size_t count = static_cast<size_t>(last - first);
+  if (count == 0) {
+    return;
+  }
+  const bool parallel = detail::is_parallel_policy<
+      typename std::decay<ExecutionPolicy>::type>::value;
+  ThreadPool* pool = parallel ? &detail::execution_pool() : nullptr;
+  const size_t workers = pool != nullptr ? pool->size() : 1;
+
+  std::vector<size_t> starts;
+  detail::plan_chunks(
+      count, workers,
+      [first](size_t i) { return detail::as_segment(first[i]).size; },
+      starts);
+
+  // Per-worker buffers for the inputs of a chunk as Segments and for its
+  // digests, which are then copied to `out`.
+  struct Scratch {
+    std::vector<Segment> segments;
+    std::vector<Digest> digests;
+  };
+  std::vector<Scratch> scratch(workers);
+  auto hash_chunk = [&](size_t worker, size_t chunk) {
+    const size_t begin = starts[chunk];
+    const size_t size = starts[chunk + 1] - begin;
+    Scratch& own = scratch[worker];
+    own.segments.resize(size);
+    own.digests.resize(size);
+    for (size_t i = 0; i < size; i++) {
+      own.segments[i] = detail::as_segment(first[begin + i]);
+    }
+    Hasher::hash_many(own.segments.data(), size, own.digests.data());
+    for (size_t i = 0; i < size; i++) {
+      out[begin + i] = own.digests[i];
+    }
+  };
+
+  const size_t chunks = starts.size() - 1;
+  if (pool != nullptr && chunks > 1) {
+    pool->run(chunks, hash_chunk);
+  } else {
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+      hash_chunk(0, chunk);
+    }
+  }
+}
+}  // namespace sha
+
+#endif  // __cpp_lib_execution
+
+#endif  // SHA_EXECUTION_H_
@@ -0,0 +1,138 @@
+/*
+ * sha_file.h
+ *
+ * This header file defines sha::hash_file and sha::hash_fd, which hash the
+ * contents of a file without first reading it into memory. Regular files are
+ * memory-mapped and the mapped pages are passed straight to the compression
+ * function; pipes, character devices and files that cannot be mapped are
+ * read with pread (or read, where the file is not seekable) into a large
+ * page-aligned buffer. Errors are reported with std::system_error.
+ *
+ * The interface is available on POSIX systems.
+ */
+
+#ifndef SHA_FILE_H_
+#define SHA_FILE_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <system_error>
+
+#include "sha.h"
+
+namespace sha {
+
+namespace detail {
+
+// The number of mapped bytes hashed between read-ahead hints. Asking the
+// kernel for the next window while the current one is hashed keeps the disk
+// busy without pinning the page cache for the whole file at once.
+static const size_t FILE_MAP_WINDOW = 64 << 20;
+
+// The size of the buffer used when the file cannot be mapped.
+static const size_t FILE_READ_BUFFER = 1 << 20;
+
+// Throws std::system_error for the current errno.
+[[noreturn]] inline void throw_errno(const char* what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+// Feeds `size` bytes of the regular file `fd` to `context` through a
+// read-only mapping. Returns false, with nothing hashed, if the file cannot
+// be mapped.
+inline bool hash_mapped(int fd, size_t size, Hasher& context) {
+  void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  const uint8_t* data = static_cast<const uint8_t*>(map);
+  madvise(map, size, MADV_SEQUENTIAL);
+  madvise(map, std::min(size, FILE_MAP_WINDOW), MADV_WILLNEED);
+  for (size_t offset = 0; offset < size; offset += FILE_MAP_WINDOW) {
+    size_t next = offset + FILE_MAP_WINDOW;
+    if (next < size) {
+      madvise(const_cast<uint8_t*>(data) + next,
+              std::min(size - next, FILE_MAP_WINDOW), MADV_WILLNEED);
+    }
+    context.update(data + offset, std::min(size - offset, FILE_MAP_WINDOW));
+  }
+  munmap(map, size);
+  return true;
+}
+
+// Feeds everything that can be read from `fd`, starting at its beginning if
+// it is seekable, to `context` through a page-aligned buffer.
+inline void hash_read(int fd, Hasher& context) {
+  void* buffer = nullptr;
+  if (posix_memalign(&buffer, 4096, FILE_READ_BUFFER) != 0) {
+    throw std::bad_alloc();
+  }
+  std::unique_ptr<void, void (*)(void*)> guard(buffer, std::free);
+  bool seekable = true;
+  off_t offset = 0;
+  for (;;) {
+    ssize_t n = seekable ? pread(fd, buffer, FILE_READ_BUFFER, offset)
+                         : read(fd, buffer, FILE_READ_BUFFER);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (seekable && errno == ESPIPE) {
+        seekable = false;
+        continue;
+      }
+      throw_errno("sha::hash_fd: read failed");
+    }
+    if (n == 0) {
+      return;
+    }
+    context.update(buffer, static_cast<size_t>(n));
+    offset += n;
+  }
+}
+}  // namespace detail
+
+// Computes the `algorithm` digest of the contents of the open file `fd`,
+// which is not closed. Regular files are hashed from a memory mapping;
+// anything else, e.g. a pipe, is read until end of file. Throws
+// std::system_error on read errors.
+inline AnyDigest hash_fd(int fd, Algorithm algorithm) {
+  Hasher context(algorithm);
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    detail::throw_errno("sha::hash_fd: fstat failed");
+  }
+  // Some regular files, e.g. in /proc, report a size of zero but do have
+  // contents; those are read like pipes.
+  if (!S_ISREG(info.st_mode) || info.st_size <= 0 ||
+      !detail::hash_mapped(fd, static_cast<size_t>(info.st_size), context)) {
+    detail::hash_read(fd, context);
+  }
+  return context.finalize_digest();
+}
+
+// Computes the `algorithm` digest of the file at `path`. Throws
+// std::system_error if the file cannot be opened or read.
+inline AnyDigest hash_file(const std::string& path, Algorithm algorithm) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    detail::throw_errno(("sha::hash_file: cannot open " + path).c_str());
+  }
+  struct Closer {
+    int fd;
+    ~Closer() { close(fd); }
+  } closer = {fd};
+  return hash_fd(fd, algorithm);
+}
+}  // namespace sha
+
+#endif  // SHA_FILE_H_
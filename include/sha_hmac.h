@@ -0,0 +1,173 @@
+/*
+ * sha_hmac.h
+ *
+ * This header file defines sha::HMAC, the keyed-hash message authentication
+ * code of RFC 2104 over the SHA-2 classes of sha.h, e.g. HMAC<SHA256> or
+ * HMAC<SHA512>. The hash states after the key's inner and outer pad blocks
+ * are computed once when the key is set and copied for every message, so a
+ * MAC costs two compressions fewer than hashing the padded key each time.
+ */
+
+#ifndef SHA_HMAC_H_
+#define SHA_HMAC_H_
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "sha.h"
+
+namespace sha {
+
+// Computes HMACs with the SHA-2 class `Hasher` under a fixed key. The object
+// is also a streaming context: init() starts a message, update() appends to
+// it and finalize_digest() returns its MAC. Copies share no state and can be
+// used from different threads.
+template <typename Hasher>
+class HMAC {
+ public:
+  static constexpr size_t DIGEST_SIZE = Hasher::DIGEST_SIZE;
+  typedef typename Hasher::Digest Digest;
+
+  // Creates an HMAC keyed with the `key_len` bytes at `key`. Keys longer than
+  // the hash block size are replaced by their digest, as RFC 2104 specifies.
+  HMAC(const void* key, size_t key_len) {
+    uint8_t block[Hasher::BLOCK_SIZE] = {0};
+    if (key_len > Hasher::BLOCK_SIZE) {
+      Hasher key_hash;
+      key_hash.update(key, key_len);
+      Digest digest = key_hash.finalize_digest();
+      std::copy(digest.begin(), digest.end(), block);
+    } else if (key_len > 0) {
+      std::memcpy(block, key, key_len);
+    }
+
+    for (size_t i = 0; i < Hasher::BLOCK_SIZE; i++) {
+      block[i] ^= IPAD;
+    }
+    inner_start.update(block, Hasher::BLOCK_SIZE);
+    for (size_t i = 0; i < Hasher::BLOCK_SIZE; i++) {
+      block[i] ^= IPAD ^ OPAD;
+    }
+    outer_start.update(block, Hasher::BLOCK_SIZE);
+
+    // Do not leave the padded key behind on the stack.
+    volatile uint8_t* wipe = block;
+    for (size_t i = 0; i < Hasher::BLOCK_SIZE; i++) {
+      wipe[i] = 0;
+    }
+    inner = inner_start;
+  }
+
+  // Creates an HMAC keyed with the bytes of `key`.
+  explicit HMAC(const std::string& key) : HMAC(key.data(), key.size()) {}
+
+  // Starts a new message under the same key.
+  void init() { inner = inner_start; }
+
+  // Appends `len` bytes at `data` to the message.
+  void update(const void* data, size_t len) { inner.update(data, len); }
+
+  // Completes the message and returns its MAC, then starts a new message.
+  Digest finalize_digest() {
+    Digest mac = finish(inner);
+    inner = inner_start;
+    return mac;
+  }
+
+  // Completes the message and returns its MAC in hexadecimal.
+  std::string finalize() { return AnyDigest(finalize_digest()).hex(); }
+
+  // Completes the message and writes its MAC in hexadecimal to `out`, which
+  // must have room for Hasher::HEX_SIZE characters, then starts a new
+  // message.
+  void finalize(char* out) { AnyDigest(finalize_digest()).hex(out); }
+
+  // Computes the MAC of the `len` bytes at `data`, leaving any message
+  // being streamed untouched.
+  Digest digest(const void* data, size_t len) const {
+    Hasher context = inner_start;
+    context.update(data, len);
+    return finish(context);
+  }
+
+  // Computes the MAC of the NUL-terminated string `data`.
+  Digest digest(const char* data) const {
+    return digest(data, std::strlen(data));
+  }
+
+  // Computes the MAC of the bytes of `data`.
+  Digest digest(const std::string& data) const {
+    return digest(data.data(), data.size());
+  }
+
+#ifdef SHA_HAS_STRING_VIEW
+  // Computes the MAC of the bytes of `data`.
+  Digest digest(std::string_view data) const {
+    return digest(data.data(), data.size());
+  }
+#endif
+
+  // Returns whether the MAC of the `len` bytes at `data` is `expected`. The
+  // MACs are compared in constant time, so a forger learns nothing from how
+  // long a rejected tag took.
+  bool verify(const void* data, size_t len, const Digest& expected) const {
+    Digest mac = digest(data, len);
+    return constant_time_equal(mac.data(), expected.data(), mac.size());
+  }
+
+  // Returns whether the MAC of the `len` bytes at `data` is the hexadecimal
+  // MAC `hex`, in either case. A malformed `hex` fails without hashing.
+  bool verify(const void* data, size_t len, const std::string& hex) const {
+    Digest expected;
+    if (hex.size() != Hasher::HEX_SIZE ||
+        !hex_decode(hex.data(), hex.size(), expected.data())) {
+      return false;
+    }
+    return verify(data, len, expected);
+  }
+
+  // Computes the MAC of the `len` bytes at `data` in hexadecimal.
+  std::string hash(const void* data, size_t len) const {
+    return AnyDigest(digest(data, len)).hex();
+  }
+
+  // Computes the MAC of the `len` bytes at `data` and writes it in
+  // hexadecimal to `out`, which must have room for Hasher::HEX_SIZE
+  // characters.
+  void hash(const void* data, size_t len, char* out) const {
+    AnyDigest(digest(data, len)).hex(out);
+  }
+
+  // Computes the MAC of the NUL-terminated string `data` in hexadecimal.
+  std::string hash(const char* data) const {
+    return hash(data, std::strlen(data));
+  }
+
+  // Computes the MAC of the bytes of `data` in hexadecimal.
+  std::string hash(const std::string& data) const {
+    return hash(data.data(), data.size());
+  }
+
+ private:
+  static const uint8_t IPAD = 0x36;
+  static const uint8_t OPAD = 0x5c;
+
+  // Completes the inner hash `context` of a message and returns the MAC.
+  Digest finish(Hasher& context) const {
+    Digest inner_digest = context.finalize_digest();
+    Hasher outer = outer_start;
+    outer.update(inner_digest.data(), inner_digest.size());
+    return outer.finalize_digest();
+  }
+
+  // The hash states after the inner and outer pad blocks of the key.
+  Hasher inner_start;
+  Hasher outer_start;
+
+  // The inner hash of the message being streamed.
+  Hasher inner;
+};
+}  // namespace sha
+
+#endif  // SHA_HMAC_H_
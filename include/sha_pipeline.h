@@ -0,0 +1,752 @@
+/*
+ * sha_pipeline.h
+ *
+ * This header file defines sha::FilePipeline, which hashes many files
+ * concurrently while keeping the storage device busy. Each worker thread owns
+ * an io_uring instance and keeps several large reads in flight across the
+ * files it is working on, opened with O_DIRECT so that the data bypasses the
+ * page cache; completed buffers are fed to the streaming contexts of their
+ * files in offset order while the kernel serves the remaining reads. Where
+ * io_uring is unavailable (older kernels, seccomp filters or non-Linux
+ * systems), the workers hash one file each with pread instead.
+ *
+ * Results are delivered through a callback as each file completes, in input
+ * order as a vector, or through a std::future for callers that wait on an
+ * asynchronous batch. The interface is available on POSIX systems.
+ */
+
+#ifndef SHA_PIPELINE_H_
+#define SHA_PIPELINE_H_
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "sha.h"
+#include "sha_file.h"
+#include "sha_thread_pool.h"
+
+// The io_uring engine talks to the kernel through the raw system calls, so it
+// needs only the kernel headers and not liburing. Define SHA_DISABLE_IO_URING
+// to build only the pread engine.
+#if !defined(SHA_DISABLE_IO_URING) && defined(__linux__) && \
+    defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+// The kernel header pulls in a BLOCK_SIZE macro that would clash with the
+// BLOCK_SIZE members of the hash classes.
+#pragma push_macro("BLOCK_SIZE")
+#include <linux/io_uring.h>
+#pragma pop_macro("BLOCK_SIZE")
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define SHA_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+namespace sha {
+
+// The outcome of hashing one file: its digest, or the error that stopped it.
+struct FileResult {
+  AnyDigest digest;
+  std::error_code error;
+};
+
+// Tuning knobs of a FilePipeline.
+struct FilePipelineOptions {
+  // Worker threads, including the calling thread. Zero selects one per
+  // hardware thread.
+  size_t threads = 0;
+
+  // Reads each worker keeps in flight with io_uring.
+  size_t queue_depth = 32;
+
+  // Bytes per read, rounded up to a multiple of 4096 for O_DIRECT.
+  size_t buffer_size = 256 * 1024;
+
+  // Opens files with O_DIRECT where the file system supports it.
+  bool direct_io = true;
+
+  // Uses io_uring where the kernel provides it; otherwise pread.
+  bool io_uring = true;
+};
+
+namespace detail {
+
+// The alignment of O_DIRECT buffers, offsets and lengths.
+static const size_t DIRECT_IO_ALIGNMENT = 4096;
+
+// Reads up to `len` bytes at `offset` of `fd`, retrying on EINTR. Returns the
+// number of bytes read or -errno.
+inline ssize_t pread_retry(int fd, void* buffer, size_t len, off_t offset) {
+  for (;;) {
+    ssize_t n = pread(fd, buffer, len, offset);
+    if (n >= 0 || errno != EINTR) {
+      return n < 0 ? -errno : n;
+    }
+  }
+}
+
+// Turns O_DIRECT off for `fd`, e.g. before an unaligned read.
+inline void clear_direct_io(int fd) {
+#ifdef O_DIRECT
+  int flags = fcntl(fd, F_GETFL);
+  if (flags >= 0 && (flags & O_DIRECT) != 0) {
+    fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+  }
+#else
+  (void)fd;
+#endif
+}
+
+// Opens `path` for reading, with O_DIRECT if `direct` is set and the file
+// system accepts it. Returns the descriptor or -errno.
+inline int open_for_hashing(const std::string& path, bool direct) {
+  int flags = O_RDONLY | O_CLOEXEC;
+#ifdef O_DIRECT
+  if (direct) {
+    int fd = open(path.c_str(), flags | O_DIRECT);
+    if (fd >= 0 || errno != EINVAL) {
+      return fd < 0 ? -errno : fd;
+    }
+  }
+#else
+  (void)direct;
+#endif
+  int fd = open(path.c_str(), flags);
+  return fd < 0 ? -errno : fd;
+}
+
+// Feeds `len` bytes of `fd` at `offset` to `context` by reading into
+// `buffer`, which holds `buffer_size` bytes. Falls back to buffered reads
+// once an O_DIRECT read is refused or ends unaligned. Returns the number of
+// bytes hashed, which is short only if the file shrank, or -errno.
+inline int64_t hash_range(int fd, uint64_t offset, uint64_t len,
+                          uint8_t* buffer, size_t buffer_size,
+                          Hasher& context) {
+  uint64_t done = 0;
+  while (done < len) {
+    ssize_t n = pread_retry(fd, buffer, buffer_size, offset + done);
+    if (n == -EINVAL) {
+      clear_direct_io(fd);
+      n = pread_retry(fd, buffer, buffer_size, offset + done);
+    }
+    if (n < 0) {
+      return n;
+    }
+    if (n == 0) {
+      break;
+    }
+    size_t use = static_cast<size_t>(std::min<uint64_t>(n, len - done));
+    context.update(buffer, use);
+    done += use;
+    if (n % DIRECT_IO_ALIGNMENT != 0) {
+      clear_direct_io(fd);
+    }
+  }
+  return static_cast<int64_t>(done);
+}
+
+// Hashes the open file `fd` with pread through `buffer`. Files that are not
+// regular, or report a size of zero, are read until end of file.
+inline FileResult hash_descriptor(int fd, Algorithm algorithm,
+                                  uint8_t* buffer, size_t buffer_size) {
+  FileResult result;
+  Hasher context(algorithm);
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    result.error = std::error_code(errno, std::generic_category());
+    return result;
+  }
+  if (!S_ISREG(info.st_mode) || info.st_size <= 0) {
+    clear_direct_io(fd);
+    try {
+      hash_read(fd, context);
+    } catch (const std::system_error& error) {
+      result.error = error.code();
+      return result;
+    }
+  } else {
+    int64_t n = hash_range(fd, 0, static_cast<uint64_t>(info.st_size),
+                           buffer, buffer_size, context);
+    if (n < 0) {
+      result.error = std::error_code(static_cast<int>(-n),
+                                     std::generic_category());
+      return result;
+    }
+  }
+  result.digest = context.finalize_digest();
+  return result;
+}
+
+#ifdef SHA_HAVE_IO_URING
+// A minimal io_uring instance: one submission queue of reads and its
+// completion queue, mapped with the raw system calls. Only the owning thread
+// may use it.
+class IoUring {
+ public:
+  IoUring()
+      : ring_fd(-1), sq_map(MAP_FAILED), cq_map(MAP_FAILED),
+        sqe_map(MAP_FAILED), queued(0) {}
+
+  ~IoUring() {
+    if (sqe_map != MAP_FAILED) {
+      munmap(sqe_map, sqe_size);
+    }
+    if (cq_map != MAP_FAILED && cq_map != sq_map) {
+      munmap(cq_map, cq_size);
+    }
+    if (sq_map != MAP_FAILED) {
+      munmap(sq_map, sq_size);
+    }
+    if (ring_fd >= 0) {
+      close(ring_fd);
+    }
+  }
+
+  IoUring(const IoUring&) = delete;
+  IoUring& operator=(const IoUring&) = delete;
+
+  // Sets up the queues for `entries` reads in flight. Returns false if the
+  // kernel does not provide io_uring or refuses it.
+  bool setup(unsigned entries) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (ring_fd < 0) {
+      return false;
+    }
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_map = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_map) {
+      sq_size = cq_size = std::max(sq_size, cq_size);
+    }
+    sq_map = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_map == MAP_FAILED) {
+      return false;
+    }
+    cq_map = single_map ? sq_map
+                        : mmap(nullptr, cq_size, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_POPULATE, ring_fd,
+                               IORING_OFF_CQ_RING);
+    if (cq_map == MAP_FAILED) {
+      return false;
+    }
+    sqe_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqe_map = mmap(nullptr, sqe_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sqe_map == MAP_FAILED) {
+      return false;
+    }
+
+    uint8_t* sq = static_cast<uint8_t*>(sq_map);
+    uint8_t* cq = static_cast<uint8_t*>(cq_map);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    sqes = static_cast<io_uring_sqe*>(sqe_map);
+    return true;
+  }
+
+  // Queues a read of `iov` at `offset` of `fd`, reported to wait() with
+  // `tag`. `iov` must stay valid until the read completes, and no more reads
+  // than the ring was set up for may be in flight.
+  void read(int fd, const struct iovec* iov, uint64_t offset, uint64_t tag) {
+    unsigned tail = *sq_tail;
+    unsigned index = tail & sq_mask;
+    io_uring_sqe* sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->off = offset;
+    sqe->addr = reinterpret_cast<uint64_t>(iov);
+    sqe->len = 1;
+    sqe->user_data = tag;
+    sq_array[index] = index;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    queued++;
+  }
+
+  // Submits the queued reads, waits for at least one completion and calls
+  // `reap(tag, result)` for every completed read, where `result` is the
+  // number of bytes read or -errno. Returns false, with errno set, if the
+  // kernel rejects the submission.
+  template <typename Reap>
+  bool wait(Reap reap) {
+    for (;;) {
+      long n = syscall(__NR_io_uring_enter, ring_fd, queued, 1,
+                       IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (n >= 0) {
+        queued -= static_cast<unsigned>(n);
+        break;
+      }
+      if (errno != EINTR) {
+        return false;
+      }
+    }
+    unsigned head = *cq_head;
+    unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+      const io_uring_cqe& cqe = cqes[head & cq_mask];
+      reap(cqe.user_data, cqe.res);
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    return true;
+  }
+
+ private:
+  int ring_fd;
+  void* sq_map;
+  void* cq_map;
+  void* sqe_map;
+  size_t sq_size;
+  size_t cq_size;
+  size_t sqe_size;
+  unsigned* sq_tail;
+  unsigned sq_mask;
+  unsigned* sq_array;
+  unsigned* cq_head;
+  unsigned* cq_tail;
+  unsigned cq_mask;
+  io_uring_cqe* cqes;
+  io_uring_sqe* sqes;
+  unsigned queued;  // Reads queued but not yet submitted.
+};
+#endif  // SHA_HAVE_IO_URING
+}  // namespace detail
+
+// Hashes batches of files with one algorithm on a pool of worker threads.
+// Workers take the next file of the batch whenever they have room for it, so
+// large and small files balance across the pool. With io_uring, each worker
+// has up to queue_depth reads in flight, spread over several files, and
+// hashes completed buffers while the others are read. Files are hashed at
+// the size they have when opened.
+class FilePipeline {
+ public:
+  // Called once for each file of a batch with its position in the batch.
+  // Calls come from the worker threads, one at a time.
+  typedef std::function<void(size_t index, const FileResult& result)>
+      Callback;
+
+  // Creates a pipeline for `algorithm`. Throws std::invalid_argument if the
+  // queue depth or buffer size is zero.
+  explicit FilePipeline(Algorithm algorithm,
+                        const FilePipelineOptions& options =
+                            FilePipelineOptions())
+      : algo(algorithm), pool(options.threads),
+        queue_depth(options.queue_depth),
+        buffer_size(round_up(options.buffer_size)),
+        direct_io(options.direct_io), io_uring_active(false) {
+    if (queue_depth == 0 || buffer_size == 0) {
+      throw std::invalid_argument(
+          "sha::FilePipeline: queue depth and buffer size must be non-zero");
+    }
+    workers.resize(pool.size());
+    for (Worker& worker : workers) {
+      size_t bytes = buffer_size * queue_depth;
+      void* memory = nullptr;
+      if (posix_memalign(&memory, detail::DIRECT_IO_ALIGNMENT, bytes) != 0) {
+        throw std::bad_alloc();
+      }
+      worker.buffers.reset(static_cast<uint8_t*>(memory));
+    }
+#ifdef SHA_HAVE_IO_URING
+    if (options.io_uring) {
+      io_uring_active = true;
+      for (Worker& worker : workers) {
+        worker.ring.reset(new detail::IoUring());
+        if (!worker.ring->setup(static_cast<unsigned>(queue_depth))) {
+          io_uring_active = false;
+        }
+      }
+      if (!io_uring_active) {
+        for (Worker& worker : workers) {
+          worker.ring.reset();
+        }
+      }
+    }
+#endif
+  }
+
+  // Returns the algorithm the pipeline computes.
+  Algorithm algorithm() const { return algo; }
+
+  // Returns the number of workers hashing each batch.
+  size_t threads() const { return pool.size(); }
+
+  // Returns whether the files are read with io_uring rather than pread.
+  bool uses_io_uring() const { return io_uring_active; }
+
+  // Hashes the files at `paths` and calls `callback` for each as soon as it
+  // is done, in completion order. Returns when every file has been
+  // reported. Per-file errors are reported in FileResult::error. An
+  // exception thrown by `callback` ends the batch: no further files are
+  // started, the files other workers are still reading are not reported,
+  // and the exception is rethrown once they have finished.
+  void hash(const std::vector<std::string>& paths, const Callback& callback) {
+    if (paths.empty()) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(batch_mutex);
+    std::atomic<size_t> next(0);
+    std::atomic<bool> stopped(false);
+    Batch batch = {paths, next, stopped, callback};
+    pool.run(pool.size(), [&](size_t worker, size_t) {
+#ifdef SHA_HAVE_IO_URING
+      if (workers[worker].ring) {
+        ring_loop(workers[worker], batch);
+        return;
+      }
+#endif
+      read_loop(workers[worker], batch);
+    });
+  }
+
+  // Hashes the files at `paths` and returns the results in input order.
+  std::vector<FileResult> hash(const std::vector<std::string>& paths) {
+    std::vector<FileResult> results(paths.size());
+    hash(paths, [&](size_t index, const FileResult& result) {
+      results[index] = result;
+    });
+    return results;
+  }
+
+  // Hashes the files at `paths` on a separate thread. The returned future
+  // becomes ready with the results in input order; the pipeline must outlive
+  // it.
+  std::future<std::vector<FileResult>> hash_async(
+      std::vector<std::string> paths) {
+    return std::async(std::launch::async, [this, paths]() {
+      return hash(paths);
+    });
+  }
+
+ private:
+  // The most reads of one file a worker keeps in flight, so that its queue
+  // is spread over several files.
+  static const size_t READS_PER_FILE = 4;
+
+  struct FreeDeleter {
+    void operator()(void* memory) const { std::free(memory); }
+  };
+
+  // Per-worker state reused from batch to batch.
+  struct Worker {
+    // queue_depth read buffers of buffer_size bytes each.
+    std::unique_ptr<uint8_t, FreeDeleter> buffers;
+#ifdef SHA_HAVE_IO_URING
+    std::unique_ptr<detail::IoUring> ring;
+#endif
+  };
+
+  // The batch being hashed, shared by the workers.
+  struct Batch {
+    const std::vector<std::string>& paths;
+    std::atomic<size_t>& next;  // The next file no worker has taken yet.
+    std::atomic<bool>& stopped;  // Whether a callback has thrown.
+    const Callback& callback;
+  };
+
+  static size_t round_up(size_t size) {
+    return (size + detail::DIRECT_IO_ALIGNMENT - 1) /
+           detail::DIRECT_IO_ALIGNMENT * detail::DIRECT_IO_ALIGNMENT;
+  }
+
+  static std::error_code errno_code(int error) {
+    return std::error_code(error, std::generic_category());
+  }
+
+  // Reports the result of file `index` of the batch, unless a callback has
+  // thrown. A throwing callback stops the workers from taking more files.
+  void deliver(const Batch& batch, size_t index, const FileResult& result) {
+    std::lock_guard<std::mutex> lock(callback_mutex);
+    if (batch.stopped.load()) {
+      return;
+    }
+    try {
+      batch.callback(index, result);
+    } catch (...) {
+      batch.stopped.store(true);
+      batch.next.store(batch.paths.size());
+      throw;
+    }
+  }
+
+  // Hashes the files the worker takes from the batch one at a time with
+  // pread.
+  void read_loop(Worker& worker, const Batch& batch) {
+    for (;;) {
+      size_t index = batch.next.fetch_add(1);
+      if (index >= batch.paths.size()) {
+        return;
+      }
+      FileResult result;
+      int fd = detail::open_for_hashing(batch.paths[index], direct_io);
+      if (fd < 0) {
+        result.error = errno_code(-fd);
+      } else {
+        result = detail::hash_descriptor(fd, algo, worker.buffers.get(),
+                                         buffer_size);
+        close(fd);
+      }
+      deliver(batch, index, result);
+    }
+  }
+
+#ifdef SHA_HAVE_IO_URING
+  struct OpenFile;
+
+  // A read buffer and the read it is used for.
+  struct Slot {
+    struct iovec iov;
+    OpenFile* file;
+    uint64_t offset;
+    int result;
+  };
+
+  // A file the worker is hashing. Its reads may complete in any order and
+  // wait in `ready` until the bytes before them have been hashed.
+  struct OpenFile {
+    explicit OpenFile(Algorithm algorithm) : context(algorithm) {}
+    ~OpenFile() { close(fd); }
+
+    size_t index;
+    int fd;
+    uint64_t size;
+    uint64_t issued;   // Offset of the next read to queue.
+    uint64_t hashed;   // Bytes fed to `context` so far.
+    size_t in_flight;  // Reads queued or waiting in `ready`.
+    int error;
+    std::vector<Slot*> ready;
+    Hasher context;
+  };
+
+  // Hashes files taken from the batch with the worker's ring until none are
+  // left, keeping up to queue_depth reads in flight.
+  void ring_loop(Worker& worker, const Batch& batch) {
+    std::vector<Slot> slots(queue_depth);
+    std::vector<Slot*> free_slots;
+    for (size_t i = 0; i < queue_depth; i++) {
+      slots[i].iov.iov_base = worker.buffers.get() + i * buffer_size;
+      slots[i].iov.iov_len = buffer_size;
+      free_slots.push_back(&slots[i]);
+    }
+    std::vector<std::unique_ptr<OpenFile>> files;
+    size_t pending = 0;  // Reads submitted but not completed.
+    bool more = true;
+
+    try {
+      for (;;) {
+        // Take new files while buffers are free.
+        while (more && !free_slots.empty() && files.size() < queue_depth) {
+          size_t index = batch.next.fetch_add(1);
+          if (index >= batch.paths.size()) {
+            more = false;
+            break;
+          }
+          std::unique_ptr<OpenFile> file = open_file(worker, batch, index);
+          if (file) {
+            files.push_back(std::move(file));
+          }
+        }
+
+        // Queue reads, round-robin over the open files.
+        for (bool queued = true; queued && !free_slots.empty();) {
+          queued = false;
+          for (std::unique_ptr<OpenFile>& file : files) {
+            if (free_slots.empty()) {
+              break;
+            }
+            if (file->error != 0 || file->issued >= file->size ||
+                file->in_flight >= READS_PER_FILE) {
+              continue;
+            }
+            Slot* slot = free_slots.back();
+            free_slots.pop_back();
+            slot->file = file.get();
+            slot->offset = file->issued;
+            worker.ring->read(file->fd, &slot->iov, slot->offset,
+                              reinterpret_cast<uint64_t>(slot));
+            file->issued += buffer_size;
+            file->in_flight++;
+            pending++;
+            queued = true;
+          }
+        }
+
+        if (pending == 0) {
+          if (!more) {
+            break;
+          }
+          continue;
+        }
+        if (!worker.ring->wait([&](uint64_t tag, int result) {
+              Slot* slot = reinterpret_cast<Slot*>(tag);
+              slot->result = result;
+              slot->file->ready.push_back(slot);
+              pending--;
+            })) {
+          throw std::system_error(errno, std::generic_category(),
+                                  "sha::FilePipeline: io_uring_enter failed");
+        }
+
+        // Hash completed buffers in offset order and report finished files.
+        for (size_t i = 0; i < files.size();) {
+          OpenFile& file = *files[i];
+          consume_ready(file, free_slots);
+          if (file.in_flight == 0 &&
+              (file.error != 0 || file.hashed >= file.size)) {
+            FileResult result;
+            if (file.error != 0) {
+              result.error = errno_code(file.error);
+            } else {
+              result.digest = file.context.finalize_digest();
+            }
+            size_t index = file.index;
+            files.erase(files.begin() + i);
+            deliver(batch, index, result);
+          } else {
+            i++;
+          }
+        }
+      }
+    } catch (...) {
+      // The kernel may still be writing to the buffers; let the reads finish
+      // before the stack goes away. If even that fails, dropping the ring
+      // cancels them and the worker continues with pread.
+      while (pending > 0) {
+        if (!worker.ring->wait([&](uint64_t, int) { pending--; })) {
+          worker.ring.reset();
+          break;
+        }
+      }
+      throw;
+    }
+  }
+
+  // Opens file `index` of the batch for the ring. Files that cannot be read
+  // with offsets, or are empty, are hashed directly and reported; null is
+  // returned for them.
+  std::unique_ptr<OpenFile> open_file(Worker& worker, const Batch& batch,
+                                      size_t index) {
+    FileResult result;
+    int fd = detail::open_for_hashing(batch.paths[index], direct_io);
+    if (fd < 0) {
+      result.error = errno_code(-fd);
+      deliver(batch, index, result);
+      return nullptr;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) ||
+        info.st_size <= 0) {
+      result = detail::hash_descriptor(fd, algo, worker.buffers.get(),
+                                       buffer_size);
+      close(fd);
+      deliver(batch, index, result);
+      return nullptr;
+    }
+    std::unique_ptr<OpenFile> file(new OpenFile(algo));
+    file->index = index;
+    file->fd = fd;
+    file->size = static_cast<uint64_t>(info.st_size);
+    file->issued = 0;
+    file->hashed = 0;
+    file->in_flight = 0;
+    file->error = 0;
+    return file;
+  }
+
+  // Feeds the completed reads of `file` that continue its hashed prefix to
+  // its context and returns their buffers to `free_slots`. A short read is
+  // completed with buffered pread; reads past a shrunken end are dropped.
+  void consume_ready(OpenFile& file, std::vector<Slot*>& free_slots) {
+    for (bool progress = true; progress;) {
+      progress = false;
+      for (size_t i = 0; i < file.ready.size(); i++) {
+        Slot* slot = file.ready[i];
+        if (slot->offset != file.hashed && file.error == 0 &&
+            slot->offset < file.size) {
+          continue;
+        }
+        file.ready.erase(file.ready.begin() + i);
+        free_slots.push_back(slot);
+        file.in_flight--;
+        progress = true;
+        if (file.error == 0 && slot->offset < file.size) {
+          consume(file, *slot);
+        }
+        break;
+      }
+    }
+  }
+
+  // Hashes the buffer of the completed read `slot`, the next one of `file`.
+  void consume(OpenFile& file, Slot& slot) {
+    uint8_t* buffer = static_cast<uint8_t*>(slot.iov.iov_base);
+    uint64_t expected =
+        std::min<uint64_t>(buffer_size, file.size - slot.offset);
+    uint64_t got = slot.result > 0 ? static_cast<uint64_t>(slot.result) : 0;
+    if (slot.result < 0 && slot.result != -EINVAL) {
+      file.error = -slot.result;
+      return;
+    }
+    got = std::min(got, expected);
+    file.context.update(buffer, static_cast<size_t>(got));
+    file.hashed += got;
+    if (got < expected) {
+      // A refused O_DIRECT read or a short read: finish the range with
+      // buffered reads into the same buffer.
+      detail::clear_direct_io(file.fd);
+      int64_t n = detail::hash_range(file.fd, slot.offset + got,
+                                     expected - got, buffer, buffer_size,
+                                     file.context);
+      if (n < 0) {
+        file.error = static_cast<int>(-n);
+        return;
+      }
+      file.hashed += static_cast<uint64_t>(n);
+      if (static_cast<uint64_t>(n) < expected - got) {
+        file.size = file.hashed;  // The file shrank; stop at its new end.
+      }
+    }
+  }
+#endif  // SHA_HAVE_IO_URING
+
+  Algorithm algo;
+  ThreadPool pool;
+  size_t queue_depth;
+  size_t buffer_size;
+  bool direct_io;
+  bool io_uring_active;  // Whether every worker has an io_uring instance.
+  std::vector<Worker> workers;
+
+  // Serializes batches, which share the worker state, and callback calls.
+  std::mutex batch_mutex;
+  std::mutex callback_mutex;
+};
+}  // namespace sha
+
+#endif  // SHA_PIPELINE_H_
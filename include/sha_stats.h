@@ -0,0 +1,213 @@
+/*
+ * sha_stats.h
+ *
+ * This header file reads the hot-path statistics of the library. Builds that
+ * define SHA_ENABLE_STATS (for every translation unit, e.g. with
+ * -DSHA_ENABLE_STATS) count, per algorithm, the bytes hashed, the blocks
+ * compressed, the completed messages by size and the time spent in each
+ * phase of a hash. The counters are thread-local, so hashing threads never
+ * share a cache line; sha::stats_snapshot() sums them over all threads.
+ *
+ * Without SHA_ENABLE_STATS the hooks in sha.h compile to nothing and the
+ * functions here return zeros, so callers need no conditional code.
+ */
+
+#ifndef SHA_STATS_H_
+#define SHA_STATS_H_
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include "sha.h"
+
+namespace sha {
+
+// Whether this build collects statistics.
+#ifdef SHA_ENABLE_STATS
+static const bool STATS_ENABLED = true;
+#else
+static const bool STATS_ENABLED = false;
+#endif
+
+// The counters of one algorithm.
+struct AlgorithmStats {
+  uint64_t bytes;          // Bytes fed to the hash.
+  uint64_t blocks;         // Blocks compressed, including padding blocks.
+  uint64_t messages;       // Completed messages.
+  uint64_t message_bytes;  // Total size of the completed messages.
+
+  // Completed messages by size: the buckets hold messages of up to 64, 256,
+  // 1024, 4096 and 65536 bytes and 1 MiB, each excluding the smaller
+  // buckets, and the last one holds the larger messages.
+  uint64_t calls[detail::STATS_BUCKETS];
+
+  // Time spent in compression, padding, digest serialization and hex
+  // formatting. The unit is time stamp counter ticks on x86 and nanoseconds
+  // elsewhere.
+  uint64_t compress_cycles;
+  uint64_t pad_cycles;
+  uint64_t serialize_cycles;
+  uint64_t hex_cycles;
+};
+
+// A point-in-time copy of the statistics of every algorithm and the names of
+// the backends in use.
+struct StatsSnapshot {
+  AlgorithmStats algorithms[ALGORITHM_COUNT];
+  const char* backend_32;        // Compression of SHA-224 and SHA-256.
+  const char* backend_64;        // Compression of the SHA-512 family.
+  const char* multi_backend_32;  // hash_many of SHA-224 and SHA-256.
+  const char* multi_backend_64;  // hash_many of the SHA-512 family.
+
+  // Returns the counters of `algorithm`.
+  const AlgorithmStats& operator[](Algorithm algorithm) const {
+    return algorithms[static_cast<size_t>(algorithm)];
+  }
+
+  // Formats the snapshot in the Prometheus text exposition format.
+  std::string prometheus() const {
+    static const char* const PHASE_NAMES[] = {"compress", "pad", "serialize",
+                                              "hex"};
+    std::ostringstream out;
+    out << "# HELP sha_bytes_total Bytes fed to the hash functions.\n"
+        << "# TYPE sha_bytes_total counter\n";
+    for (size_t a = 0; a < ALGORITHM_COUNT; a++) {
+      out << "sha_bytes_total" << label(a) << " " << algorithms[a].bytes
+          << "\n";
+    }
+    out << "# HELP sha_blocks_total Blocks compressed.\n"
+        << "# TYPE sha_blocks_total counter\n";
+    for (size_t a = 0; a < ALGORITHM_COUNT; a++) {
+      out << "sha_blocks_total" << label(a) << " " << algorithms[a].blocks
+          << "\n";
+    }
+    out << "# HELP sha_message_bytes Sizes of the completed messages.\n"
+        << "# TYPE sha_message_bytes histogram\n";
+    for (size_t a = 0; a < ALGORITHM_COUNT; a++) {
+      const AlgorithmStats& stats = algorithms[a];
+      std::string name = algorithm_name(static_cast<Algorithm>(a));
+      uint64_t cumulative = 0;
+      for (size_t b = 0; b < detail::STATS_BUCKETS; b++) {
+        cumulative += stats.calls[b];
+        out << "sha_message_bytes_bucket{algorithm=\"" << name << "\",le=\"";
+        if (b + 1 < detail::STATS_BUCKETS) {
+          out << detail::STATS_BUCKET_LIMITS[b];
+        } else {
+          out << "+Inf";
+        }
+        out << "\"} " << cumulative << "\n";
+      }
+      out << "sha_message_bytes_sum" << label(a) << " " << stats.message_bytes
+          << "\n"
+          << "sha_message_bytes_count" << label(a) << " " << stats.messages
+          << "\n";
+    }
+    out << "# HELP sha_phase_cycles_total Time spent per phase, in TSC ticks "
+           "on x86 and nanoseconds elsewhere.\n"
+        << "# TYPE sha_phase_cycles_total counter\n";
+    for (size_t a = 0; a < ALGORITHM_COUNT; a++) {
+      const AlgorithmStats& stats = algorithms[a];
+      const uint64_t cycles[] = {stats.compress_cycles, stats.pad_cycles,
+                                 stats.serialize_cycles, stats.hex_cycles};
+      for (size_t p = 0; p < 4; p++) {
+        out << "sha_phase_cycles_total{algorithm=\""
+            << algorithm_name(static_cast<Algorithm>(a)) << "\",phase=\""
+            << PHASE_NAMES[p] << "\"} " << cycles[p] << "\n";
+      }
+    }
+    out << "# HELP sha_backend_info The compression backends in use.\n"
+        << "# TYPE sha_backend_info gauge\n"
+        << backend_line("sha256", "single", backend_32)
+        << backend_line("sha512", "single", backend_64)
+        << backend_line("sha256", "multi", multi_backend_32)
+        << backend_line("sha512", "multi", multi_backend_64);
+    return out.str();
+  }
+
+ private:
+  static std::string label(size_t algorithm) {
+    return std::string("{algorithm=\"") +
+           algorithm_name(static_cast<Algorithm>(algorithm)) + "\"}";
+  }
+
+  static std::string backend_line(const char* family, const char* kind,
+                                  const char* backend) {
+    return std::string("sha_backend_info{family=\"") + family +
+           "\",kind=\"" + kind + "\",backend=\"" + backend + "\"} 1\n";
+  }
+};
+
+namespace detail {
+
+// Sums the counters of all threads, less the baseline, into `totals`.
+// Without SHA_ENABLE_STATS the totals are zero.
+inline void stats_totals(uint64_t (&totals)[ALGORITHM_COUNT][STATS_FIELDS]) {
+  for (auto& fields : totals) {
+    for (uint64_t& value : fields) {
+      value = 0;
+    }
+  }
+#ifdef SHA_ENABLE_STATS
+  StatsRegistry& registry = stats_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (size_t a = 0; a < ALGORITHM_COUNT; a++) {
+    for (size_t f = 0; f < STATS_FIELDS; f++) {
+      uint64_t value = registry.retired[a][f] - registry.baseline[a][f];
+      for (const ThreadStats* thread : registry.threads) {
+        value += thread->values[a][f].load(std::memory_order_relaxed);
+      }
+      totals[a][f] = value;
+    }
+  }
+#endif
+}
+}  // namespace detail
+
+// Returns the statistics collected since the start of the program or the
+// last reset_stats(), summed over all threads.
+inline StatsSnapshot stats_snapshot() {
+  uint64_t totals[ALGORITHM_COUNT][detail::STATS_FIELDS];
+  detail::stats_totals(totals);
+  StatsSnapshot snapshot;
+  for (size_t a = 0; a < ALGORITHM_COUNT; a++) {
+    const uint64_t* fields = totals[a];
+    AlgorithmStats& stats = snapshot.algorithms[a];
+    stats.bytes = fields[detail::STATS_BYTES];
+    stats.blocks = fields[detail::STATS_BLOCKS];
+    stats.message_bytes = fields[detail::STATS_MESSAGE_BYTES];
+    stats.messages = 0;
+    for (size_t b = 0; b < detail::STATS_BUCKETS; b++) {
+      stats.calls[b] = fields[detail::STATS_CALLS + b];
+      stats.messages += stats.calls[b];
+    }
+    stats.compress_cycles = fields[detail::STATS_COMPRESS];
+    stats.pad_cycles = fields[detail::STATS_PAD];
+    stats.serialize_cycles = fields[detail::STATS_SERIALIZE];
+    stats.hex_cycles = fields[detail::STATS_HEX];
+  }
+  snapshot.backend_32 = SHA256::backend().name;
+  snapshot.backend_64 = SHA512::backend().name;
+  snapshot.multi_backend_32 = SHA256::multi_backend().name;
+  snapshot.multi_backend_64 = SHA512::multi_backend().name;
+  return snapshot;
+}
+
+// Restarts the statistics from zero.
+inline void reset_stats() {
+#ifdef SHA_ENABLE_STATS
+  uint64_t totals[ALGORITHM_COUNT][detail::STATS_FIELDS];
+  detail::StatsRegistry& registry = detail::stats_registry();
+  // Totals are relative to the current baseline; fold them into it.
+  detail::stats_totals(totals);
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (size_t a = 0; a < ALGORITHM_COUNT; a++) {
+    for (size_t f = 0; f < detail::STATS_FIELDS; f++) {
+      registry.baseline[a][f] += totals[a][f];
+    }
+  }
+#endif
+}
+}  // namespace sha
+
+#endif  // SHA_STATS_H_
@@ -0,0 +1,196 @@
+/*
+ * sha_thread_pool.h
+ *
+ * This header file defines sha::ThreadPool, a small work-stealing thread pool
+ * used by the parallel hashing interfaces of the library. A pool owns a fixed
+ * set of worker threads and runs batches of independent, indexed tasks on
+ * them; the thread that submits a batch works on it as well.
+ */
+
+#ifndef SHA_THREAD_POOL_H_
+#define SHA_THREAD_POOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sha {
+
+// Runs batches of independent tasks on a fixed set of worker threads. The
+// tasks of a batch are split into one contiguous range per worker; a worker
+// takes tasks from the front of its own range and, once that is empty, steals
+// from the back of the ranges of the others, so a batch of uneven tasks still
+// keeps every worker busy until it is done. The thread calling run() acts as
+// worker 0.
+class ThreadPool {
+ public:
+  // The task run for each index of a batch. `worker` is the index of the
+  // executing worker, in [0, size()), and can be used to select per-worker
+  // scratch state.
+  typedef std::function<void(size_t worker, size_t index)> Task;
+
+  // Creates a pool of `threads` workers, counting the thread that calls
+  // run(). Zero selects std::thread::hardware_concurrency().
+  explicit ThreadPool(size_t threads = 0)
+      : generation(0), stopping(false), current(nullptr), pending(0) {
+    if (threads == 0) {
+      threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < threads; i++) {
+      queues.emplace_back(new Queue());
+    }
+    for (size_t i = 1; i < threads; i++) {
+      workers.emplace_back(&ThreadPool::work, this, i);
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+      worker.join();
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Returns the number of workers, including the thread calling run().
+  size_t size() const { return queues.size(); }
+
+  // Runs task(worker, index) for every index in [0, count) and returns when
+  // all of them have finished. If tasks throw, the remaining tasks still run
+  // and the first exception is rethrown here. Batches submitted from several
+  // threads run one after another.
+  void run(size_t count, const Task& task) {
+    if (count == 0) {
+      return;
+    }
+    std::lock_guard<std::mutex> batch(run_mutex);
+    current = &task;
+    error = nullptr;
+    pending.store(count, std::memory_order_relaxed);
+
+    // Handing each worker a contiguous range keeps neighbouring tasks, which
+    // usually touch neighbouring data, on the same thread.
+    const size_t threads = size();
+    for (size_t i = 0; i < threads; i++) {
+      std::lock_guard<std::mutex> lock(queues[i]->mutex);
+      queues[i]->begin = count * i / threads;
+      queues[i]->end = count * (i + 1) / threads;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      generation++;
+    }
+    wake.notify_all();
+
+    drain(0);
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] {
+      return pending.load(std::memory_order_acquire) == 0;
+    });
+    current = nullptr;
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+ private:
+  // The task indices [begin, end) still waiting in one worker's range.
+  struct Queue {
+    std::mutex mutex;
+    size_t begin = 0;
+    size_t end = 0;
+  };
+
+  // Takes the next task for `worker`: the front of its own range if that is
+  // not empty, else the back of another worker's range.
+  bool pop(size_t worker, size_t* index) {
+    const size_t threads = size();
+    {
+      Queue& own = *queues[worker];
+      std::lock_guard<std::mutex> lock(own.mutex);
+      if (own.begin < own.end) {
+        *index = own.begin++;
+        return true;
+      }
+    }
+    for (size_t i = 1; i < threads; i++) {
+      Queue& victim = *queues[(worker + i) % threads];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (victim.begin < victim.end) {
+        *index = --victim.end;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Runs tasks on `worker` until no range has any left.
+  void drain(size_t worker) {
+    size_t index;
+    while (pop(worker, &index)) {
+      try {
+        (*current)(worker, index);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+      if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.notify_all();
+      }
+    }
+  }
+
+  // The loop of worker thread `worker`: sleeps until a batch is submitted and
+  // helps to drain it.
+  void work(size_t worker) {
+    size_t seen = 0;
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping) {
+          return;
+        }
+        seen = generation;
+      }
+      drain(worker);
+    }
+  }
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> workers;
+
+  // Serializes calls to run().
+  std::mutex run_mutex;
+
+  // Guards generation, stopping and error.
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  size_t generation;
+  bool stopping;
+  std::exception_ptr error;
+
+  // The task of the current batch and the number of its unfinished indices.
+  const Task* current;
+  std::atomic<size_t> pending;
+};
+}  // namespace sha
+
+#endif  // SHA_THREAD_POOL_H_
@@ -0,0 +1,341 @@
+/*
+ * sha_tree.h
+ *
+ * This header file defines sha::TreeHasher, an opt-in tree hashing mode that
+ * spreads the hashing of one large message over several cores. The message is
+ * cut into fixed-size leaves that are hashed in parallel on a sha::ThreadPool,
+ * and the leaf digests are combined pairwise into a single root digest.
+ *
+ * Leaves and interior nodes are hashed with distinct one-byte prefixes, as in
+ * the Merkle trees of RFC 6962: a leaf digest is H(0x00 || leaf) and a node
+ * digest is H(0x01 || left || right). A level with an odd number of nodes
+ * passes its last node up unchanged. The root therefore differs from the
+ * plain digest of the message and depends on the leaf size, which has to be
+ * stored alongside it.
+ *
+ * It also defines sha::MerkleTree, a tree over leaf digests that stays in
+ * memory, e.g. the entries of a ledger. Changing a leaf rehashes only its
+ * path to the root, and inclusion proofs are produced and checked over raw
+ * digests. Both classes build the same trees, which are also the trees of
+ * RFC 6962. As there, a tree without leaves, such as the tree of an empty
+ * message, has the digest of the empty string as its root.
+ */
+
+#ifndef SHA_TREE_H_
+#define SHA_TREE_H_
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "sha.h"
+#include "sha_thread_pool.h"
+
+namespace sha {
+
+// Hashes large messages in tree mode with the SHA-2 class `Hasher`, e.g.
+// TreeHasher<SHA256> or TreeHasher<SHA512>.
+template <typename Hasher>
+class TreeHasher {
+ public:
+  typedef typename Hasher::Digest Digest;
+
+  // The leaf size used when none is given: large enough that the per-leaf
+  // overhead is negligible, small enough to balance a few GB over many cores.
+  static const size_t DEFAULT_LEAF_SIZE = 1 << 20;
+
+  // The prefixes that separate leaf digests from interior node digests.
+  static const uint8_t LEAF_PREFIX = 0x00;
+  static const uint8_t NODE_PREFIX = 0x01;
+
+  // The root digest of a message together with the digests of its leaves;
+  // leaves[i] covers bytes [i * leaf_size, (i + 1) * leaf_size).
+  struct Result {
+    Digest root;
+    std::vector<Digest> leaves;
+  };
+
+  // Creates a tree hasher with leaves of `leaf_size` bytes, hashing on a pool
+  // of `threads` workers (zero selects one per hardware thread). Throws
+  // std::invalid_argument if `leaf_size` is zero.
+  explicit TreeHasher(size_t leaf_size = DEFAULT_LEAF_SIZE, size_t threads = 0)
+      : leaf_bytes(leaf_size), pool(threads) {
+    if (leaf_size == 0) {
+      throw std::invalid_argument("sha::TreeHasher: leaf size must be > 0");
+    }
+  }
+
+  // Returns the number of bytes covered by each leaf.
+  size_t leaf_size() const { return leaf_bytes; }
+
+  // Returns the number of leaves of a `len`-byte message. An empty message
+  // has none, and its root is empty_root().
+  size_t leaf_count(size_t len) const {
+    return len == 0 ? 0 : (len - 1) / leaf_bytes + 1;
+  }
+
+  // Hashes the `len` bytes at `data` and returns the root and leaf digests.
+  Result hash(const void* data, size_t len) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    Result result;
+    result.leaves.resize(leaf_count(len));
+    pool.run(result.leaves.size(), [&](size_t, size_t leaf) {
+      size_t offset = leaf * leaf_bytes;
+      size_t size = std::min(leaf_bytes, len - offset);
+      result.leaves[leaf] = leaf_digest(bytes + offset, size);
+    });
+    result.root = root(result.leaves);
+    return result;
+  }
+
+  // Hashes the `len` bytes at `data` and returns the root digest only.
+  Digest root(const void* data, size_t len) { return hash(data, len).root; }
+
+  // Returns the digest of a single leaf holding `len` bytes at `data`, e.g.
+  // to check one leaf of a stored Result without rehashing the message.
+  static Digest leaf_digest(const void* data, size_t len) {
+    Hasher context;
+    context.update(&LEAF_PREFIX, 1);
+    context.update(data, len);
+    return context.finalize_digest();
+  }
+
+  // Returns the root of a tree without leaves, the digest of the empty
+  // string as in RFC 6962.
+  static Digest empty_root() {
+    Hasher context;
+    return context.finalize_digest();
+  }
+
+  // The size of the message hashed for an interior node: the prefix and the
+  // two child digests.
+  static const size_t NODE_SIZE = 1 + 2 * Hasher::DIGEST_SIZE;
+
+  // Returns the digest of the interior node with children `left`, `right`.
+  static Digest node_digest(const Digest& left, const Digest& right) {
+    uint8_t node[NODE_SIZE];
+    node[0] = NODE_PREFIX;
+    std::copy(left.begin(), left.end(), node + 1);
+    std::copy(right.begin(), right.end(), node + 1 + Hasher::DIGEST_SIZE);
+    return Hasher::template digest_fixed<NODE_SIZE>(node);
+  }
+
+  // Computes the level above the `count` nodes at `children` into
+  // `parents` and returns its size, (count + 1) / 2. The last child of an
+  // odd level is passed up unchanged. `parents` may point to `children`, so
+  // a level can be reduced in place. The node messages are laid out in
+  // batches on the stack and hashed with the multi-buffer lanes.
+  static size_t parent_level(const Digest* children, size_t count,
+                             Digest* parents) {
+    uint8_t nodes[NODE_BATCH * NODE_SIZE];
+    const size_t pairs = count / 2;
+    for (size_t first = 0; first < pairs; first += NODE_BATCH) {
+      size_t batch = std::min(NODE_BATCH, pairs - first);
+      for (size_t i = 0; i < batch; i++) {
+        const Digest& left = children[2 * (first + i)];
+        const Digest& right = children[2 * (first + i) + 1];
+        uint8_t* node = nodes + i * NODE_SIZE;
+        node[0] = NODE_PREFIX;
+        std::copy(left.begin(), left.end(), node + 1);
+        std::copy(right.begin(), right.end(), node + 1 + Hasher::DIGEST_SIZE);
+      }
+      Hasher::template digest_fixed_many<NODE_SIZE>(nodes, batch,
+                                                    parents + first);
+    }
+    if (count % 2 == 1) {
+      parents[pairs] = children[count - 1];
+    }
+    return pairs + count % 2;
+  }
+
+  // Combines the leaf digests of a message into its root digest. Each level
+  // is hashed with parent_level(), so the small node messages share the
+  // multi-buffer lanes. No leaves give empty_root().
+  static Digest root(const std::vector<Digest>& leaves) {
+    if (leaves.empty()) {
+      return empty_root();
+    }
+    std::vector<Digest> level = leaves;
+    size_t width = level.size();
+    while (width > 1) {
+      width = parent_level(level.data(), width, level.data());
+    }
+    return level[0];
+  }
+
+ private:
+  // The node messages laid out per multi-buffer call: a few groups of the
+  // widest lanes, in 8 KiB of stack for SHA-512.
+  static const size_t NODE_BATCH = 64;
+
+  size_t leaf_bytes;
+  ThreadPool pool;
+};
+
+template <typename Hasher>
+const uint8_t TreeHasher<Hasher>::LEAF_PREFIX;
+template <typename Hasher>
+const uint8_t TreeHasher<Hasher>::NODE_PREFIX;
+template <typename Hasher>
+const size_t TreeHasher<Hasher>::NODE_SIZE;
+template <typename Hasher>
+const size_t TreeHasher<Hasher>::NODE_BATCH;
+
+// A Merkle tree over leaf digests of the SHA-2 class `Hasher`, e.g.
+// MerkleTree<SHA256>, hashed like TreeHasher: leaf digests are
+// H(0x00 || leaf) and the last node of an odd level is passed up unchanged.
+// All levels are kept in one array, leaves first and the root last, so a
+// level is built from the one below it in a single pass and a changed leaf
+// is rehashed along its path only. Throws std::out_of_range for a leaf index
+// past the end.
+template <typename Hasher>
+class MerkleTree {
+ public:
+  typedef typename Hasher::Digest Digest;
+  typedef TreeHasher<Hasher> Tree;
+
+  // Creates a tree without leaves, whose root is Tree::empty_root().
+  MerkleTree() { build(nullptr, 0); }
+
+  // Creates the tree over the `count` leaf digests at `leaves`.
+  MerkleTree(const Digest* leaves, size_t count) { build(leaves, count); }
+
+  // Creates the tree over the leaf digests in `leaves`.
+  explicit MerkleTree(const std::vector<Digest>& leaves) {
+    build(leaves.data(), leaves.size());
+  }
+
+  // Creates the tree whose leaves hold the `count` messages at `leaves`.
+  static MerkleTree from_data(const Segment* leaves, size_t count) {
+    std::vector<Digest> digests(count);
+    for (size_t i = 0; i < count; i++) {
+      digests[i] = Tree::leaf_digest(leaves[i].data, leaves[i].size);
+    }
+    return MerkleTree(digests);
+  }
+
+  // Returns the number of leaves.
+  size_t size() const { return level_begin[1]; }
+
+  // Returns the digest of leaf `index`.
+  const Digest& leaf(size_t index) const {
+    check(index);
+    return nodes[index];
+  }
+
+  // Returns the root digest.
+  Digest root() const {
+    return nodes.empty() ? Tree::empty_root() : nodes.back();
+  }
+
+  // Replaces leaf `index` with the leaf digest `leaf` and rehashes the
+  // nodes above it, one per level.
+  void update_leaf(size_t index, const Digest& leaf) {
+    check(index);
+    nodes[index] = leaf;
+    for (size_t level = 0; level + 2 < level_begin.size(); level++) {
+      const Digest* row = &nodes[level_begin[level]];
+      size_t width = level_begin[level + 1] - level_begin[level];
+      size_t left = index & ~static_cast<size_t>(1);
+      index /= 2;
+      Digest& parent = nodes[level_begin[level + 1] + index];
+      parent = left + 1 < width ? Tree::node_digest(row[left], row[left + 1])
+                                : row[left];
+    }
+  }
+
+  // Replaces leaf `index` with a leaf holding the `len` bytes at `data`.
+  void update_leaf(size_t index, const void* data, size_t len) {
+    update_leaf(index, Tree::leaf_digest(data, len));
+  }
+
+  // Returns the inclusion proof of leaf `index`: the sibling digests on the
+  // path to the root, bottom up, as in the audit paths of RFC 6962. Levels
+  // where the path node is passed up have no sibling and add nothing.
+  std::vector<Digest> proof(size_t index) const {
+    check(index);
+    std::vector<Digest> path;
+    for (size_t level = 0; level + 2 < level_begin.size(); level++) {
+      size_t sibling = index ^ 1;
+      if (sibling < level_begin[level + 1] - level_begin[level]) {
+        path.push_back(nodes[level_begin[level] + sibling]);
+      }
+      index /= 2;
+    }
+    return path;
+  }
+
+  // Returns whether the `proof_len` digests at `proof` prove that the leaf
+  // digest `leaf` is leaf `index` of a tree of `count` leaves with root
+  // `root`, following the verification algorithm of RFC 9162.
+  static bool verify(const Digest& leaf, size_t index, size_t count,
+                     const Digest* proof, size_t proof_len,
+                     const Digest& root) {
+    if (index >= count) {
+      return false;
+    }
+    size_t node = index;
+    size_t last = count - 1;
+    Digest digest = leaf;
+    for (size_t i = 0; i < proof_len; i++) {
+      if (last == 0) {
+        return false;
+      }
+      if (node % 2 == 1 || node == last) {
+        digest = Tree::node_digest(proof[i], digest);
+        // Skip the levels where this node is passed up unchanged.
+        while (node % 2 == 0 && node != 0) {
+          node /= 2;
+          last /= 2;
+        }
+      } else {
+        digest = Tree::node_digest(digest, proof[i]);
+      }
+      node /= 2;
+      last /= 2;
+    }
+    return last == 0 && digest == root;
+  }
+
+  // Returns whether `proof` proves that `leaf` is leaf `index` of a tree of
+  // `count` leaves with root `root`.
+  static bool verify(const Digest& leaf, size_t index, size_t count,
+                     const std::vector<Digest>& proof, const Digest& root) {
+    return verify(leaf, index, count, proof.data(), proof.size(), root);
+  }
+
+ private:
+  // Lays out the levels above `count` leaves and hashes them bottom up.
+  void build(const Digest* leaves, size_t count) {
+    level_begin.assign(1, 0);
+    size_t width = count;
+    size_t end = count;
+    level_begin.push_back(end);
+    while (width > 1) {
+      width = (width + 1) / 2;
+      end += width;
+      level_begin.push_back(end);
+    }
+    nodes.resize(end);
+    std::copy(leaves, leaves + count, nodes.begin());
+    for (size_t level = 1; level + 1 < level_begin.size(); level++) {
+      Tree::parent_level(&nodes[level_begin[level - 1]],
+                         level_begin[level] - level_begin[level - 1],
+                         &nodes[level_begin[level]]);
+    }
+  }
+
+  void check(size_t index) const {
+    if (index >= size()) {
+      throw std::out_of_range("sha::MerkleTree: leaf index out of range");
+    }
+  }
+
+  std::vector<Digest> nodes;
+  // level_begin[l] is the index in `nodes` of the first node of level l,
+  // counted from the leaves; the last entry is the number of nodes.
+  std::vector<size_t> level_begin;
+};
+}  // namespace sha
+
+#endif  // SHA_TREE_H_
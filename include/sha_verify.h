@@ -0,0 +1,102 @@
+/*
+ * sha_verify.h
+ *
+ * This header file defines sha::Verifier, which checks a streamed message,
+ * e.g. an upload arriving in chunks, against an expected digest. The expected
+ * digest is decoded once when the verifier is created and compared with the
+ * computed one in constant time. When the length of the message is known in
+ * advance, a message that runs past it is rejected at once and its remaining
+ * bytes are never compressed.
+ */
+
+#ifndef SHA_VERIFY_H_
+#define SHA_VERIFY_H_
+
+#include <cstdint>
+#include <string>
+
+#include "sha.h"
+
+namespace sha {
+
+// Verifies messages against an expected digest of the SHA-2 class `Hasher`,
+// e.g. Verifier<SHA256>. Feed the message with update() and call finalize()
+// for the verdict; failed() tells early that the message can no longer
+// match, so the caller can stop receiving it.
+template <typename Hasher>
+class Verifier {
+ public:
+  typedef typename Hasher::Digest Digest;
+
+  // Passed as the expected length when it is not known in advance.
+  static const uint64_t ANY_LENGTH = UINT64_MAX;
+
+  // Expects messages of `expected_len` bytes whose digest is `expected`.
+  explicit Verifier(const Digest& expected,
+                    uint64_t expected_len = ANY_LENGTH)
+      : expected(expected), expected_len(expected_len), malformed(false) {
+    init();
+  }
+
+  // Expects messages of `expected_len` bytes whose digest is the
+  // hexadecimal digest `hex`, in either case. If `hex` is not
+  // Hasher::HEX_SIZE hexadecimal digits, every message fails without being
+  // hashed.
+  explicit Verifier(const std::string& hex,
+                    uint64_t expected_len = ANY_LENGTH)
+      : expected(), expected_len(expected_len), malformed(false) {
+    malformed = hex.size() != Hasher::HEX_SIZE ||
+                !hex_decode(hex.data(), hex.size(), expected.data());
+    init();
+  }
+
+  // Starts a new message against the same expectation.
+  void init() {
+    context.init();
+    received = 0;
+    mismatch = malformed;
+  }
+
+  // Appends `len` bytes at `data` to the message. Nothing is hashed once the
+  // message is known to fail.
+  void update(const void* data, size_t len) {
+    if (mismatch) {
+      return;
+    }
+    received += len;
+    if (expected_len != ANY_LENGTH && received > expected_len) {
+      mismatch = true;
+      return;
+    }
+    context.update(data, len);
+  }
+
+  // Returns whether the message is already known not to match: the
+  // expected digest was malformed or more bytes arrived than expected.
+  bool failed() const { return mismatch; }
+
+  // Completes the message and returns whether it matches, then starts a new
+  // message. A message of the wrong length fails without being padded.
+  bool finalize() {
+    bool matches = false;
+    if (!mismatch &&
+        (expected_len == ANY_LENGTH || received == expected_len)) {
+      Digest actual = context.finalize_digest();
+      matches = constant_time_equal(actual.data(), expected.data(),
+                                    actual.size());
+    }
+    init();
+    return matches;
+  }
+
+ private:
+  Hasher context;
+  Digest expected;
+  uint64_t expected_len;
+  uint64_t received;  // Bytes of the current message so far.
+  bool malformed;     // Whether the expected hex digest failed to decode.
+  bool mismatch;      // Whether the current message can no longer match.
+};
+}  // namespace sha
+
+#endif  // SHA_VERIFY_H_
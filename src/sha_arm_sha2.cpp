@@ -0,0 +1,10 @@
+/*
+ * sha_arm_sha2.cpp
+ *
+ * The SHA-256 kernel of libsha for the ARMv8 Crypto Extensions, compiled
+ * with -march=armv8-a+crypto.
+ */
+
+#define SHA_USE_LIBRARY 1
+#define SHA_BUILD_ARM_SHA2 1
+#include "sha.h"
@@ -0,0 +1,11 @@
+/*
+ * sha_arm_sha512.cpp
+ *
+ * The SHA-512 kernel of libsha for the ARMv8.2 SHA-512 instructions,
+ * compiled with -march=armv8.2-a+sha3. It has its own translation unit
+ * because CPUs with the SHA-256 instructions may lack these.
+ */
+
+#define SHA_USE_LIBRARY 1
+#define SHA_BUILD_ARM_SHA512 1
+#include "sha.h"
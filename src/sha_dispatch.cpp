@@ -0,0 +1,15 @@
+/*
+ * sha_dispatch.cpp
+ *
+ * The backend tables of libsha, compiled with the baseline flags. They pick
+ * a kernel from the per-ISA translation units at runtime, after checking the
+ * CPU, and fall back to the unrolled and portable code otherwise.
+ *
+ * The per-ISA translation units hold nothing but their kernels. Any other
+ * inline function they used would be emitted with their -m flags, and the
+ * linker could keep that copy for the callers compiled here.
+ */
+
+#define SHA_USE_LIBRARY 1
+#define SHA_BUILD_DISPATCH 1
+#include "sha.h"
@@ -0,0 +1,10 @@
+/*
+ * sha_x86_avx2.cpp
+ *
+ * The AVX2 kernels of libsha, compiled with -mavx2 -mbmi2: eight-lane SHA-256
+ * and four-lane SHA-512 multi-buffer compression, and single-stream SHA-512.
+ */
+
+#define SHA_USE_LIBRARY 1
+#define SHA_BUILD_X86_AVX2 1
+#include "sha.h"
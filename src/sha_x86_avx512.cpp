@@ -0,0 +1,10 @@
+/*
+ * sha_x86_avx512.cpp
+ *
+ * The AVX-512F kernels of libsha, compiled with -mavx512f: sixteen-lane
+ * SHA-256 and eight-lane SHA-512 multi-buffer compression.
+ */
+
+#define SHA_USE_LIBRARY 1
+#define SHA_BUILD_X86_AVX512 1
+#include "sha.h"
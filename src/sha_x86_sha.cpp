@@ -0,0 +1,10 @@
+/*
+ * sha_x86_sha.cpp
+ *
+ * The SHA-256 kernel of libsha for the x86 SHA extensions, compiled with
+ * -msha -mssse3 -msse4.1.
+ */
+
+#define SHA_USE_LIBRARY 1
+#define SHA_BUILD_X86_SHA 1
+#include "sha.h"
@@ -0,0 +1,646 @@
+/*
+ * test_differential.cpp
+ *
+ * This file cross-checks the compression backends of `sha.h` against each
+ * other and measures every one of them in the same run, so that a faster
+ * kernel cannot ship with a wrong digest. For every algorithm it:
+ *
+ * - generates messages of every length from 0 to 3 blocks and of random
+ *   lengths, with random contents, and computes their reference digests with
+ *   the `portable` backend,
+ * - hashes every message with every single-stream backend the CPU supports,
+ *   both in one call and streamed in random pieces, and in batches of every
+ *   size up to a few lane groups with every multi-buffer backend, and compares
+ *   the digests with the reference,
+ * - checks the NIST example messages and the NIST CAVP response files named
+ *   on the command line (SHA256ShortMsg.rsp, SHA512_256Monte.rsp, ...) with
+ *   every backend,
+ * - measures the throughput of each backend on 1 MiB messages and its time
+ *   per 64-byte message, for multi-buffer backends within a batch.
+ *
+ * It prints one line per backend and exits with status 1 if any digest
+ * differs. The random seed is printed, so a failing run can be repeated with
+ * --seed. Run with --help for the options.
+ *
+ * This file relies on the `sha.h` header for the SHA implementations and
+ * requires compilation with C++11 or later.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "sha.h"  // Include SHA implementation
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Command line settings.
+struct Options {
+    uint64_t seed = 0;
+    bool seed_given = false;
+    size_t messages = 1000;  // Random-length messages per algorithm.
+    size_t max_size = 16384;
+    double budget = 0.05;  // Seconds of timing per measurement; 0 skips it.
+    std::string format = "table";
+    std::string algorithms = "all";
+    std::vector<std::string> files;
+};
+
+// A message with its expected digest, from the NIST examples or a ShortMsg
+// or LongMsg response file.
+struct KnownAnswer {
+    std::string label;
+    std::vector<uint8_t> message;
+    std::vector<uint8_t> digest;
+};
+
+// A Monte Carlo test of a Monte response file: the seed and the expected
+// digest of each of the 100 checkpoints.
+struct MonteCarlo {
+    std::string label;
+    std::vector<uint8_t> seed;
+    std::vector<std::vector<uint8_t>> checkpoints;
+};
+
+// The vectors of one algorithm, named as in the CAVP file names.
+struct VectorSet {
+    std::string algorithm;
+    std::vector<KnownAnswer> known;
+    std::vector<MonteCarlo> monte;
+};
+
+// The outcome of one backend.
+struct Result {
+    const char* algorithm;
+    const char* kind;  // "single" or "multi".
+    const char* backend;
+    bool supported;
+    size_t checks;
+    size_t failures;
+    double gbps;      // On 1 MiB messages; zero when not measured.
+    double small_ns;  // Per 64-byte message; zero when not measured.
+};
+
+// Keeps the compiler from discarding the digests of the timed loops.
+volatile uint8_t sink;
+
+// The most mismatches printed per backend.
+const size_t MAX_REPORTED = 5;
+
+// Counts a comparison of `result` and prints the first mismatches.
+void check(Result& result, bool equal, const std::string& what, size_t len,
+           const Options& options) {
+    result.checks++;
+    if (equal) {
+        return;
+    }
+    if (++result.failures <= MAX_REPORTED) {
+        std::printf("MISMATCH %s %s backend %s: %s, %zu bytes (--seed=%llu)\n",
+                    result.algorithm, result.kind, result.backend,
+                    what.c_str(), len, (unsigned long long)options.seed);
+    }
+}
+
+template <typename Digest>
+bool same(const Digest& digest, const std::vector<uint8_t>& expected) {
+    return expected.size() == digest.size() &&
+           std::equal(digest.begin(), digest.end(), expected.begin());
+}
+
+// Returns the median time of one call of `run` in nanoseconds, sampled for
+// `budget` seconds after a warm-up.
+template <typename Run>
+double median_ns(Run run, double budget) {
+    run();
+    size_t iterations = 1;
+    for (;;) {
+        auto start = Clock::now();
+        for (size_t i = 0; i < iterations; i++) {
+            run();
+        }
+        double elapsed =
+            std::chrono::duration<double>(Clock::now() - start).count();
+        if (elapsed >= 10e-6 || iterations >= (size_t(1) << 24)) {
+            break;
+        }
+        iterations *= 2;
+    }
+    std::vector<double> samples;
+    auto deadline = Clock::now() + std::chrono::duration<double>(budget);
+    while (samples.size() < 5 || Clock::now() < deadline) {
+        auto start = Clock::now();
+        for (size_t i = 0; i < iterations; i++) {
+            run();
+        }
+        samples.push_back(std::chrono::duration<double, std::nano>(
+                              Clock::now() - start)
+                              .count() /
+                          iterations);
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+std::vector<uint8_t> random_bytes(std::mt19937_64& rng, size_t len) {
+    std::vector<uint8_t> bytes(len);
+    for (uint8_t& byte : bytes) {
+        byte = (uint8_t)rng();
+    }
+    return bytes;
+}
+
+std::vector<uint8_t> from_text(const char* text) {
+    return std::vector<uint8_t>(text, text + std::strlen(text));
+}
+
+// Adds the example messages of the NIST SHA-2 documentation and the
+// million-'a' message to the vectors of each algorithm.
+void add_nist_examples(std::vector<VectorSet>& sets) {
+    static const char* const TWO_BLOCK_256 =
+        "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    static const char* const TWO_BLOCK_512 =
+        "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmno"
+        "ijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu";
+    static const struct {
+        const char* algorithm;
+        const char* digests[5];  // "", "abc", 448 bits, 896 bits, 10^6 'a'.
+    } EXAMPLES[] = {
+        {"SHA224",
+         {"d14a028c2a3a2bc9476102bb288234c415a2b01f828ea62ac5b3e42f",
+          "23097d223405d8228642a477bda255b32aadbce4bda0b3f7e36c9da7",
+          "75388b16512776cc5dba5da1fd890150b0c6455cb4f58b1952522525",
+          "c97ca9a559850ce97a04a96def6d99a9e0e0e2ab14e6b8df265fc0b3",
+          "20794655980c91d8bbb4c1ea97618a4bf03f42581948b2ee4ee7ad67"}},
+        {"SHA256",
+         {"e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+          "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+          "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",
+          "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1",
+          "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"}},
+        {"SHA384",
+         {"38b060a751ac96384cd9327eb1b1e36a21fdb71114be07434c0cc7bf63f6e1da"
+          "274edebfe76f65fbd51ad2f14898b95b",
+          "cb00753f45a35e8bb5a03d699ac65007272c32ab0eded1631a8b605a43ff5bed"
+          "8086072ba1e7cc2358baeca134c825a7",
+          "3391fdddfc8dc7393707a65b1b4709397cf8b1d162af05abfe8f450de5f36bc6"
+          "b0455a8520bc4e6f5fe95b1fe3c8452b",
+          "09330c33f71147e83d192fc782cd1b4753111b173b3b05d22fa08086e3b0f712"
+          "fcc7c71a557e2db966c3e9fa91746039",
+          "9d0e1809716474cb086e834e310a4a1ced149e9c00f248527972cec5704c2a5b"
+          "07b8b3dc38ecc4ebae97ddd87f3d8985"}},
+        {"SHA512",
+         {"cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
+          "47d0d13c5d85f2b0ff8318d2877eec2f63b931bd47417a81a538327af927da3e",
+          "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+          "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f",
+          "204a8fc6dda82f0a0ced7beb8e08a41657c16ef468b228a8279be331a703c335"
+          "96fd15c13b1b07f9aa1d3bea57789ca031ad85c7a71dd70354ec631238ca3445",
+          "8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb6889018"
+          "501d289e4900f7e4331b99dec4b5433ac7d329eeb6dd26545e96e55b874be909",
+          "e718483d0ce769644e2e42c7bc15b4638e1f98b13b2044285632a803afa973eb"
+          "de0ff244877ea60a4cb0432ce577c31beb009c5c2c49aa2e4eadb217ad8cc09b"}},
+        {"SHA512_224",
+         {"6ed0dd02806fa89e25de060c19d3ac86cabb87d6a0ddd05c333b84f4",
+          "4634270f707b6a54daae7530460842e20e37ed265ceee9a43e8924aa",
+          "e5302d6d54bb242275d1e7622d68df6eb02dedd13f564c13dbda2174",
+          "23fec5bb94d60b23308192640b0c453335d664734fe40e7268674af9",
+          "37ab331d76f0d36de422bd0edeb22a28accd487b7a8453ae965dd287"}},
+        {"SHA512_256",
+         {"c672b8d1ef56ed28ab87c3622c5114069bdd3ad7b8f9737498d0c01ecef0967a",
+          "53048e2681941ef99b2e29b76b4c7dabe4c2d0c634fc6d46e0e2f13107e7af23",
+          "bde8e1f9f19bb9fd3406c90ec6bc47bd36d8ada9f11880dbc8a22a7078b6a461",
+          "3928e184fb8690f840da3988121d31be65cb9d3ef83ee6146feac861e19b563a",
+          "9a59a052930187a97038cae692f30708aa6491923ef5194394dc68d56c74fb21"}},
+    };
+    static const char* const LABELS[] = {"NIST empty message", "NIST \"abc\"",
+                                         "NIST 448-bit message",
+                                         "NIST 896-bit message",
+                                         "NIST million 'a'"};
+    const std::vector<uint8_t> messages[] = {
+        std::vector<uint8_t>(), from_text("abc"), from_text(TWO_BLOCK_256),
+        from_text(TWO_BLOCK_512), std::vector<uint8_t>(1000000, 'a')};
+    for (const auto& example : EXAMPLES) {
+        VectorSet set;
+        set.algorithm = example.algorithm;
+        for (size_t i = 0; i < 5; i++) {
+            KnownAnswer known;
+            known.label = LABELS[i];
+            known.message = messages[i];
+            known.digest.resize(std::strlen(example.digests[i]) / 2);
+            sha::hex_decode(example.digests[i], 2 * known.digest.size(),
+                            known.digest.data());
+            set.known.push_back(known);
+        }
+        sets.push_back(set);
+    }
+}
+
+// Returns the hexadecimal value of a "Name = value" line of a response file.
+std::vector<uint8_t> hex_value(const std::string& line) {
+    std::string hex = line.substr(line.find('=') + 1);
+    hex.erase(std::remove(hex.begin(), hex.end(), ' '), hex.end());
+    std::vector<uint8_t> bytes(hex.size() / 2);
+    if (!sha::hex_decode(hex.data(), 2 * bytes.size(), bytes.data())) {
+        bytes.clear();
+    }
+    return bytes;
+}
+
+// Reads a CAVP response file of the SHA Validation System. The algorithm is
+// taken from the file name, e.g. SHA512_224LongMsg.rsp. Messages whose
+// length is not a whole number of bytes are skipped.
+bool read_response_file(const std::string& path, std::vector<VectorSet>& sets) {
+    static const char* const ALGORITHMS[] = {"SHA512_224", "SHA512_256",
+                                             "SHA224",     "SHA256",
+                                             "SHA384",     "SHA512"};
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    VectorSet set;
+    for (const char* algorithm : ALGORITHMS) {
+        if (name.compare(0, std::strlen(algorithm), algorithm) == 0) {
+            set.algorithm = algorithm;
+            break;
+        }
+    }
+    std::ifstream in(path.c_str());
+    if (set.algorithm.empty() || !in) {
+        std::fprintf(stderr, "cannot read SHA-2 vectors from %s\n",
+                     path.c_str());
+        return false;
+    }
+    size_t bits = 0;
+    std::vector<uint8_t> message;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.compare(0, 6, "Len = ") == 0) {
+            bits = std::strtoull(line.c_str() + 6, nullptr, 10);
+        } else if (line.compare(0, 6, "Msg = ") == 0) {
+            message = hex_value(line);
+            message.resize(bits / 8);
+        } else if (line.compare(0, 7, "Seed = ") == 0) {
+            MonteCarlo monte;
+            monte.label = name + " Monte Carlo";
+            monte.seed = hex_value(line);
+            set.monte.push_back(monte);
+        } else if (line.compare(0, 5, "MD = ") == 0) {
+            if (!set.monte.empty()) {
+                set.monte.back().checkpoints.push_back(hex_value(line));
+            } else if (bits % 8 == 0) {
+                KnownAnswer known;
+                known.label = name + " Len = " + std::to_string(bits);
+                known.message = message;
+                known.digest = hex_value(line);
+                set.known.push_back(known);
+            }
+        }
+    }
+    sets.push_back(set);
+    return true;
+}
+
+// Runs the Monte Carlo test of SHAVS: each checkpoint is the last of 1000
+// digests of the three digests before it, and seeds the next checkpoint.
+template <typename Hasher>
+void check_monte_carlo(const MonteCarlo& monte, Result& result,
+                       const Options& options) {
+    const size_t size = Hasher::DIGEST_SIZE;
+    if (monte.seed.size() != size) {
+        check(result, false, monte.label + " seed size", monte.seed.size(),
+              options);
+        return;
+    }
+    std::vector<uint8_t> seed = monte.seed;
+    std::vector<uint8_t> window(3 * size);
+    for (size_t j = 0; j < monte.checkpoints.size(); j++) {
+        for (size_t i = 0; i < 3; i++) {
+            std::copy(seed.begin(), seed.end(), window.begin() + i * size);
+        }
+        typename Hasher::Digest digest;
+        for (int i = 3; i < 1003; i++) {
+            digest = Hasher().digest(window.data(), window.size());
+            std::memmove(window.data(), window.data() + size, 2 * size);
+            std::copy(digest.begin(), digest.end(), window.begin() + 2 * size);
+        }
+        check(result, same(digest, monte.checkpoints[j]),
+              monte.label + " COUNT = " + std::to_string(j), window.size(),
+              options);
+        seed.assign(digest.begin(), digest.end());
+    }
+}
+
+// Cross-checks and measures every backend of `Hasher`, whose vectors are
+// named `cavp_name` in `sets`, and restores the default backends afterwards.
+template <typename Hasher, typename Word>
+void run_algorithm(const char* algorithm, const char* cavp_name,
+                   const std::vector<VectorSet>& sets, const Options& options,
+                   std::vector<Result>& results,
+                   void (*report)(const Result&)) {
+    typedef typename Hasher::Digest Digest;
+    const size_t block = Hasher::BLOCK_SIZE;
+    std::mt19937_64 rng(options.seed);
+    std::vector<std::vector<uint8_t>> messages;
+    for (size_t len = 0; len <= 3 * block; len++) {
+        messages.push_back(random_bytes(rng, len));
+    }
+    for (size_t i = 0; i < options.messages; i++) {
+        // Half of the lengths are near the short-message and padding paths.
+        size_t len = rng() % 2 == 0 ? rng() % (4 * block + 1)
+                                    : rng() % (options.max_size + 1);
+        messages.push_back(random_bytes(rng, len));
+    }
+
+    const std::string original = Hasher::backend().name;
+    const std::string original_multi = Hasher::multi_backend().name;
+    Hasher::set_backend("portable");
+    std::vector<Digest> reference;
+    for (const std::vector<uint8_t>& message : messages) {
+        reference.push_back(Hasher().digest(message.data(), message.size()));
+    }
+    std::vector<uint8_t> long_message = random_bytes(rng, 1 << 20);
+    std::vector<uint8_t> small_messages = random_bytes(rng, 64 * 1024);
+
+    size_t count;
+    const sha::CompressBackend<Word>* backends = Hasher::backends(&count);
+    for (size_t b = 0; b < count; b++) {
+        Result result = {algorithm, "single", backends[b].name, false, 0, 0,
+                         0, 0};
+        if (Hasher::set_backend(backends[b].name)) {
+            result.supported = true;
+            for (size_t i = 0; i < messages.size(); i++) {
+                const std::vector<uint8_t>& message = messages[i];
+                check(result,
+                      Hasher().digest(message.data(), message.size()) ==
+                          reference[i],
+                      "one-shot", message.size(), options);
+                Hasher context;
+                for (size_t offset = 0; offset < message.size();) {
+                    size_t piece = std::min<size_t>(rng() % (2 * block + 1),
+                                                    message.size() - offset);
+                    context.update(message.data() + offset, piece);
+                    offset += piece;
+                }
+                check(result, context.finalize_digest() == reference[i],
+                      "streamed", message.size(), options);
+                if (message.size() == 32) {
+                    check(result, Hasher::digest32(message.data()) ==
+                                      reference[i],
+                          "digest32", 32, options);
+                } else if (message.size() == 64) {
+                    check(result, Hasher::digest64(message.data()) ==
+                                      reference[i],
+                          "digest64", 64, options);
+                }
+            }
+            for (const VectorSet& set : sets) {
+                if (set.algorithm != cavp_name) {
+                    continue;
+                }
+                for (const KnownAnswer& known : set.known) {
+                    check(result,
+                          same(Hasher().digest(known.message.data(),
+                                               known.message.size()),
+                               known.digest),
+                          known.label, known.message.size(), options);
+                }
+                for (const MonteCarlo& monte : set.monte) {
+                    check_monte_carlo<Hasher>(monte, result, options);
+                }
+            }
+            if (options.budget > 0) {
+                double ns = median_ns(
+                    [&] {
+                        sink = sink ^ Hasher().digest(long_message.data(),
+                                                      long_message.size())[0];
+                    },
+                    options.budget);
+                result.gbps = long_message.size() / ns;
+                result.small_ns = median_ns(
+                    [&] {
+                        sink = sink ^
+                               Hasher().digest(small_messages.data(), 64)[0];
+                    },
+                    options.budget);
+            }
+        }
+        results.push_back(result);
+        report(result);
+    }
+    Hasher::set_backend(original.c_str());
+
+    std::vector<sha::Segment> segments;
+    for (const std::vector<uint8_t>& message : messages) {
+        segments.push_back(sha::Segment{message.data(), message.size()});
+    }
+    std::vector<sha::Segment> small_segments;
+    for (size_t i = 0; i < small_messages.size() / 64; i++) {
+        small_segments.push_back(
+            sha::Segment{small_messages.data() + 64 * i, 64});
+    }
+    std::vector<Digest> digests(messages.size());
+    const sha::MultiBufferBackend<Word>* multi = Hasher::multi_backends(&count);
+    for (size_t b = 0; b < count; b++) {
+        Result result = {algorithm, "multi", multi[b].name, false, 0, 0, 0, 0};
+        if (Hasher::set_multi_backend(multi[b].name)) {
+            result.supported = true;
+            Hasher::hash_many(segments.data(), segments.size(),
+                              digests.data());
+            for (size_t i = 0; i < messages.size(); i++) {
+                check(result, digests[i] == reference[i], "batch",
+                      messages[i].size(), options);
+            }
+            // Batches of every size up to two full groups of the widest
+            // lanes and one more, at varying offsets, end in every possible
+            // partial group.
+            const size_t max_batch =
+                std::min<size_t>(2 * 16 + 1, messages.size());
+            for (size_t batch = 1; batch <= max_batch; batch++) {
+                size_t first = rng() % (messages.size() - batch + 1);
+                Hasher::hash_many(segments.data() + first, batch,
+                                  digests.data());
+                for (size_t i = 0; i < batch; i++) {
+                    check(result, digests[i] == reference[first + i],
+                          "batch of " + std::to_string(batch),
+                          messages[first + i].size(), options);
+                }
+            }
+            if (options.budget > 0) {
+                std::vector<Digest> out(small_segments.size());
+                result.small_ns =
+                    median_ns(
+                        [&] {
+                            Hasher::hash_many(small_segments.data(),
+                                              small_segments.size(),
+                                              out.data());
+                            sink = sink ^ out[0][0];
+                        },
+                        options.budget) /
+                    small_segments.size();
+            }
+        }
+        results.push_back(result);
+        report(result);
+    }
+    Hasher::set_multi_backend(original_multi.c_str());
+}
+
+const char* status(const Result& r) {
+    return !r.supported ? "skipped" : r.failures == 0 ? "ok" : "FAIL";
+}
+
+// Prints a line of the human-readable table as soon as it is measured.
+// Unmeasured figures are shown as "-".
+void report_table(const Result& r) {
+    char gbps[16] = "-";
+    char small_ns[16] = "-";
+    if (r.gbps > 0) {
+        std::snprintf(gbps, sizeof(gbps), "%.3f", r.gbps);
+    }
+    if (r.small_ns > 0) {
+        std::snprintf(small_ns, sizeof(small_ns), "%.1f", r.small_ns);
+    }
+    std::printf("%-12s %-7s %-10s %-8s %8zu %8zu %9s %9s\n", r.algorithm,
+                r.kind, r.backend, status(r), r.checks, r.failures, gbps,
+                small_ns);
+    std::fflush(stdout);
+}
+
+void report_none(const Result&) {}
+
+void print_csv(const std::vector<Result>& results) {
+    std::printf("algorithm,kind,backend,status,checks,failures,gbps,"
+                "ns_per_64_bytes\n");
+    for (const Result& r : results) {
+        std::printf("%s,%s,%s,%s,%zu,%zu,%.4f,%.2f\n", r.algorithm, r.kind,
+                    r.backend, status(r), r.checks, r.failures, r.gbps,
+                    r.small_ns);
+    }
+}
+
+void usage() {
+    std::cout
+        << "Usage: test_differential [options] [CAVP .rsp files]\n"
+        << "  --seed=N          Seed of the random messages (default random)\n"
+        << "  --messages=N      Random-length messages per algorithm "
+           "(default 1000)\n"
+        << "  --max-size=N      Longest random message (default 16384)\n"
+        << "  --budget=SECONDS  Timing per measurement, 0 to skip "
+           "(default 0.05)\n"
+        << "  --format=table|csv  Output format (default table)\n"
+        << "  --algorithms=LIST e.g. sha256,sha512 (default all)\n"
+        << "Response files are matched to algorithms by name, e.g. "
+           "SHA256ShortMsg.rsp.\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value = arg.substr(arg.find('=') + 1);
+        if (arg.compare(0, 7, "--seed=") == 0) {
+            options.seed = std::strtoull(value.c_str(), nullptr, 0);
+            options.seed_given = true;
+        } else if (arg.compare(0, 11, "--messages=") == 0) {
+            options.messages = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg.compare(0, 11, "--max-size=") == 0) {
+            options.max_size = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg.compare(0, 9, "--budget=") == 0) {
+            options.budget = std::atof(value.c_str());
+        } else if (arg.compare(0, 9, "--format=") == 0) {
+            options.format = value;
+        } else if (arg.compare(0, 13, "--algorithms=") == 0) {
+            options.algorithms = value;
+        } else if (arg.compare(0, 2, "--") != 0) {
+            options.files.push_back(arg);
+        } else {
+            usage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    if (options.format != "table" && options.format != "csv") {
+        usage();
+        return 1;
+    }
+    if (!options.seed_given) {
+        std::random_device device;
+        options.seed = ((uint64_t)device() << 32) | device();
+    }
+
+    std::vector<VectorSet> sets;
+    add_nist_examples(sets);
+    for (const std::string& file : options.files) {
+        if (!read_response_file(file, sets)) {
+            return 1;
+        }
+    }
+
+    auto selected = [&](const char* name) {
+        return options.algorithms == "all" ||
+               ("," + options.algorithms + ",").find(
+                   "," + std::string(name) + ",") != std::string::npos;
+    };
+    void (*report)(const Result&) =
+        options.format == "table" ? report_table : report_none;
+    if (options.format == "table") {
+        std::printf("seed %llu\n", (unsigned long long)options.seed);
+        std::printf("%-12s %-7s %-10s %-8s %8s %8s %9s %9s\n", "algorithm",
+                    "kind", "backend", "status", "checks", "failures",
+                    "GB/s", "ns/64B");
+    }
+
+    std::vector<Result> results;
+    if (selected("sha256")) {
+        run_algorithm<sha::SHA256, uint32_t>("SHA-256", "SHA256", sets,
+                                             options, results, report);
+    }
+    if (selected("sha224")) {
+        run_algorithm<sha::SHA224, uint32_t>("SHA-224", "SHA224", sets,
+                                             options, results, report);
+    }
+    if (selected("sha512")) {
+        run_algorithm<sha::SHA512, uint64_t>("SHA-512", "SHA512", sets,
+                                             options, results, report);
+    }
+    if (selected("sha384")) {
+        run_algorithm<sha::SHA384, uint64_t>("SHA-384", "SHA384", sets,
+                                             options, results, report);
+    }
+    if (selected("sha512_224")) {
+        run_algorithm<sha::SHA512_224, uint64_t>(
+            "SHA-512/224", "SHA512_224", sets, options, results, report);
+    }
+    if (selected("sha512_256")) {
+        run_algorithm<sha::SHA512_256, uint64_t>(
+            "SHA-512/256", "SHA512_256", sets, options, results, report);
+    }
+
+    if (options.format == "csv") {
+        print_csv(results);
+    }
+    size_t failures = 0;
+    for (const Result& r : results) {
+        failures += r.failures;
+    }
+    if (failures != 0) {
+        std::printf("%zu mismatching digests (--seed=%llu)\n", failures,
+                    (unsigned long long)options.seed);
+        return 1;
+    }
+    if (options.format == "table") {
+        std::printf("All backends agree.\n");
+    }
+    return 0;
+}
@@ -4,11 +4,64 @@
  * SHA implementation is linked when compiling this test file.
 */
 
-#include <iostream>
+#include <unistd.h>
+
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <stdexcept>
 #include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
 
 #include "sha.h"
+#include "sha_batch.h"
+#include "sha_cache.h"
+#include "sha_execution.h"
+#include "sha_file.h"
+#include "sha_hmac.h"
+#include "sha_pipeline.h"
+#include "sha_stats.h"
+#include "sha_tree.h"
+#include "sha_verify.h"
+
+// Counts the global allocations of the calling thread while
+// `counting_allocations` is set, for the tests of the allocation-free
+// interfaces.
+static thread_local bool counting_allocations = false;
+static thread_local size_t allocations = 0;
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  if (counting_allocations) {
+    allocations++;
+  }
+  return std::malloc(size == 0 ? 1 : size);
+}
+void* operator new(size_t size) {
+  void* p = operator new(size, std::nothrow);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+// Not inlined, so that GCC does not see free() paired with operator new.
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+  std::free(p);
+}
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+  operator delete(p);
+}
+
+// Paragraph shared by tests that hash the same text in different ways.
+static const char* PARAGRAPH = "Bangladesh is a country of stunning natural beauty, where vibrant landscapes unfold in every direction. The lush, green countryside is adorned with sprawling rice paddies and meandering rivers, with the mighty Ganges, Brahmaputra, and Meghna rivers converging to create a labyrinth of waterways that are vital to the nation's life. The serene Sundarbans mangrove forest, a UNESCO World Heritage Site, is home to the elusive Bengal tiger and a rich array of wildlife, while the rolling hills of the Chittagong Hill Tracts offer breathtaking vistas and serene spots for reflection. The picturesque Cox’s Bazar boasts the world's longest natural sea beach, where golden sands meet the shimmering Bay of Bengal. Throughout the country, the natural beauty is complemented by a warm and welcoming culture, creating a landscape as rich in heart as it is in scenery.";
 
 void test_sha512() {
   const char* data = "Bangladesh is a country of stunning natural beauty, where vibrant landscapes unfold in every direction. The lush, green countryside is adorned with sprawling rice paddies and meandering rivers, with the mighty Ganges, Brahmaputra, and Meghna rivers converging to create a labyrinth of waterways that are vital to the nation's life. The serene Sundarbans mangrove forest, a UNESCO World Heritage Site, is home to the elusive Bengal tiger and a rich array of wildlife, while the rolling hills of the Chittagong Hill Tracts offer breathtaking vistas and serene spots for reflection. The picturesque Cox’s Bazar boasts the world's longest natural sea beach, where golden sands meet the shimmering Bay of Bengal. Throughout the country, the natural beauty is complemented by a warm and welcoming culture, creating a landscape as rich in heart as it is in scenery.";
@@ -64,6 +117,951 @@ void test_sha512_224() {
   assert(hash_digest == expected_hash_digest);
 }
 
+void test_sha256_streaming() {
+  sha::SHA256 sha256;
+  size_t len = strlen(PARAGRAPH);
+  size_t offset = 0;
+  for (size_t chunk = 1; offset < len; chunk = chunk * 3 + 1) {
+    size_t n = std::min(chunk, len - offset);
+    sha256.update(PARAGRAPH + offset, n);
+    offset += n;
+  }
+  std::string hash_digest = sha256.finalize();
+  std::string expected_hash_digest = "32ce66b1c62d176f259d153156d1cb1e80349ac08f272d6a3e0498623b67c81b";
+  std::cout << "Streaming hash digest for SHA-256: " << hash_digest << std::endl;
+  assert(hash_digest == expected_hash_digest);
+
+  // The context is reset by finalize and can be reused.
+  sha256.update(PARAGRAPH, len);
+  assert(sha256.finalize() == expected_hash_digest);
+}
+
+void test_sha384_streaming() {
+  sha::SHA384 sha384;
+  size_t len = strlen(PARAGRAPH);
+  for (size_t offset = 0; offset < len; offset += 127) {
+    sha384.update(PARAGRAPH + offset, std::min<size_t>(127, len - offset));
+  }
+  std::string hash_digest = sha384.finalize();
+  std::string expected_hash_digest = "d49233f7fed6cb61d556934e11ea9c82b86a9e4bfcd4aa48ba2140b9cf85ae0daf414a8d68aa7b4a9b752d8d9be6a041";
+  std::cout << "Streaming hash digest for SHA-384: " << hash_digest << std::endl;
+  assert(hash_digest == expected_hash_digest);
+}
+
+void test_binary_input() {
+  // Binary input with embedded NUL bytes; hashing must not stop at the first.
+  std::string data;
+  for (int i = 0; i < 20; i++) {
+    data.append("abc\0def\0\xff", 9);
+  }
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+
+  assert(sha::SHA256().hash(bytes, data.size()) == "759e4cdde1dae5ebb47327934841b16ea403518c9fb18e103674b0d577d1f1f6");
+  assert(sha::SHA224().hash(bytes, data.size()) == "20b7649099ad2fd5777d0135b4ce3460765baec13a849069d1aa1a6c");
+  assert(sha::SHA512().hash(bytes, data.size()) == "7ff6c2f8f679e4e57179e5af796d7e4b94f2dc1c501c4fb8924040ddf9ecde59be2e2017b793f08e00d0323ab0a03b1285393c16f8d89856591287b25e2fa562");
+  assert(sha::SHA384().hash(bytes, data.size()) == "819092250248ef4a83e3875aa2ff7b415413cab5af92c38bfa8b00e4f85604185f5a134174f4aef7f44b0f73ddbad641");
+  assert(sha::SHA512_224().hash(bytes, data.size()) == "7cae7813fa6119e75c88dafff0c9b65575ff8ff60df5b37702831fa0");
+  assert(sha::SHA512_256().hash(bytes, data.size()) == "fd96dcb18aaab5c9da961df4af387052838b9595f68eb397be9583fe5d2e5c56");
+
+  assert(sha::SHA256().hash(data) == sha::SHA256().hash(bytes, data.size()));
+  assert(sha::SHA512().hash(data) == sha::SHA512().hash(bytes, data.size()));
+  assert(sha::SHA256().hash(nullptr, 0) == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  std::cout << "Binary input hashing passed." << std::endl;
+}
+
+void test_raw_digest() {
+  sha::SHA256::Digest digest256 = sha::SHA256().digest(PARAGRAPH);
+  assert(digest256.size() == 32);
+  assert(digest256[0] == 0x32 && digest256[31] == 0x1b);
+
+  sha::SHA512_224::Digest digest512_224 = sha::SHA512_224().digest(PARAGRAPH);
+  assert(digest512_224.size() == 28);
+
+  // The hex encoder writes into a caller buffer without a terminating NUL.
+  char hex[sha::SHA512_224::DIGEST_SIZE * 2 + 1] = {0};
+  sha::hex_encode(digest512_224.data(), digest512_224.size(), hex);
+  assert(std::string(hex) == "c60eb03a1ae4093f39b7d26659a5c41d56a2cf4b5e1071ec13e5cb9f");
+
+  sha::SHA384 sha384;
+  sha384.update(PARAGRAPH, strlen(PARAGRAPH));
+  assert(sha384.finalize_digest() == sha::SHA384().digest(PARAGRAPH));
+  std::cout << "Raw digest output passed." << std::endl;
+}
+
+void test_caller_buffers() {
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(PARAGRAPH);
+  const size_t len = strlen(PARAGRAPH);
+  char hex[sha::SHA512::HEX_SIZE + 1] = {0};
+  sha::SHA512_224().hash(data, len, hex);
+  assert(std::string(hex) == sha::SHA512_224().hash(PARAGRAPH));
+  assert(hex[sha::SHA512_224::HEX_SIZE] == '\0');
+
+  sha::SHA256 context;
+  context.update(PARAGRAPH, len);
+  context.finalize(hex);
+  assert(std::string(hex, sha::SHA256::HEX_SIZE) ==
+         sha::SHA256().hash(PARAGRAPH));
+  sha::Hasher runtime(sha::Algorithm::SHA384);
+  runtime.update(PARAGRAPH, len);
+  assert(runtime.finalize(hex) == 96);
+  assert(std::string(hex, 96) == sha::SHA384().hash(PARAGRAPH));
+  sha::HMAC<sha::SHA256> hmac("key");
+  hmac.hash(PARAGRAPH, len, hex);
+  assert(std::string(hex, 64) == hmac.hash(PARAGRAPH));
+
+  // Once warm, a hot loop of these calls makes no heap allocations. The
+  // first hash_many of a thread sizes its pooled scratch.
+  sha::Segment inputs[9];
+  for (size_t i = 0; i < 9; i++) {
+    inputs[i] = sha::Segment{data, len - i * 50};
+  }
+  sha::SHA256::Digest digests[9];
+  sha::SHA512::Digest digests512[9];
+  sha::SHA256::Digest nodes[9];
+  sha::SHA256::hash_many(inputs, 9, digests);
+  sha::SHA512::hash_many(inputs, 9, digests512);
+  counting_allocations = true;
+  for (int i = 0; i < 100; i++) {
+    sha::SHA256().hash(data, len, hex);
+    sha::SHA512().hash(data, i, hex);
+    context.update(data, i);
+    context.finalize(hex);
+    runtime.init();
+    runtime.update(data, len);
+    runtime.finalize(hex);
+    hmac.hash(data, i, hex);
+    sha::SHA256::hash_many(inputs, 9, digests);
+    sha::SHA512::hash_many(inputs, 9, digests512);
+    sha::SHA256::digest64_many(data, 9, nodes);
+  }
+  counting_allocations = false;
+  assert(allocations == 0);
+  for (size_t i = 0; i < 9; i++) {
+    assert(digests[i] == sha::SHA256().digest(data, inputs[i].size));
+    assert(digests512[i] == sha::SHA512().digest(data, inputs[i].size));
+  }
+  std::cout << "Caller buffer test passed" << std::endl;
+}
+
+// Checks the fixed-size entry points of `Hasher` against digest() with every
+// compression and multi-buffer backend.
+template <typename Hasher, typename Word>
+void test_fixed_size(const char* name) {
+  typedef typename Hasher::Digest Digest;
+  std::vector<uint8_t> data(64 * 37);
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = (uint8_t)(i * 29 + 3);
+  }
+  std::vector<Digest> expected32, expected64, expected_double;
+  std::vector<sha::Segment> messages;
+  for (size_t i = 0; i < 37; i++) {
+    expected32.push_back(Hasher().digest(data.data() + i * 32, 32));
+    expected64.push_back(Hasher().digest(data.data() + i * 64, 64));
+    messages.push_back(sha::Segment{data.data() + i, i * 7});
+    Digest inner = Hasher().digest(data.data() + i, i * 7);
+    expected_double.push_back(Hasher().digest(inner.data(), inner.size()));
+  }
+
+  std::string original = Hasher::backend().name;
+  size_t count;
+  const sha::CompressBackend<Word>* backends = Hasher::backends(&count);
+  for (size_t b = 0; b < count; b++) {
+    if (!Hasher::set_backend(backends[b].name)) {
+      continue;
+    }
+    for (size_t i = 0; i < 37; i++) {
+      assert(Hasher::digest32(data.data() + i * 32) == expected32[i]);
+      assert(Hasher::digest64(data.data() + i * 64) == expected64[i]);
+      assert(Hasher::digest_double(data.data() + i, i * 7) ==
+             expected_double[i]);
+    }
+  }
+  assert(Hasher::set_backend(original.c_str()));
+
+  original = Hasher::multi_backend().name;
+  const sha::MultiBufferBackend<Word>* multi = Hasher::multi_backends(&count);
+  for (size_t b = 0; b < count; b++) {
+    if (!Hasher::set_multi_backend(multi[b].name)) {
+      continue;
+    }
+    // 37 messages end in a partially filled group of lanes.
+    std::vector<Digest> digests(37);
+    Hasher::digest32_many(data.data(), 37, digests.data());
+    assert(digests == expected32);
+    Hasher::digest64_many(data.data(), 37, digests.data());
+    assert(digests == expected64);
+    Hasher::digest_double_many(messages.data(), 37, digests.data());
+    assert(digests == expected_double);
+    std::vector<sha::AnyDigest> any(5);
+    Hasher::digest64_many(data.data(), 5, any.data());
+    assert(any[4] == sha::AnyDigest(expected64[4]));
+
+    // Digests no larger than a message may overwrite their inputs.
+    std::vector<uint8_t> in_place(data.begin(), data.begin() + 37 * 64);
+    Digest* in_place_digests = reinterpret_cast<Digest*>(in_place.data());
+    Hasher::digest64_many(in_place.data(), 37, in_place_digests);
+    assert(std::equal(expected64.begin(), expected64.end(),
+                      in_place_digests));
+    if (sizeof(Digest) <= 32) {
+      in_place.assign(data.begin(), data.begin() + 37 * 32);
+      in_place_digests = reinterpret_cast<Digest*>(in_place.data());
+      Hasher::digest32_many(in_place.data(), 37, in_place_digests);
+      assert(std::equal(expected32.begin(), expected32.end(),
+                        in_place_digests));
+    }
+  }
+  assert(Hasher::set_multi_backend(original.c_str()));
+  std::cout << name << " fixed-size digests passed" << std::endl;
+}
+
+// Checks every compiled-in backend of `Hasher` against the portable backend
+// for all message lengths from 0 to 300 bytes, and against the known digests
+// of PARAGRAPH for `Hasher` and its truncated variant `Truncated`, which
+// starts from other initial hash values.
+template <typename Hasher, typename Truncated, typename Word>
+void test_backends(const char* name, const char* paragraph_hex,
+                   const char* truncated_hex) {
+  std::string data;
+  for (int i = 0; i < 300; i++) {
+    data.push_back((char)(i * 37 + 11));
+  }
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+
+  std::string original = Hasher::backend().name;
+  assert(Hasher::set_backend("portable"));
+  std::vector<std::string> expected;
+  for (size_t len = 0; len <= data.size(); len++) {
+    expected.push_back(Hasher().hash(bytes, len));
+  }
+
+  size_t count;
+  const sha::CompressBackend<Word>* backends = Hasher::backends(&count);
+  for (size_t i = 0; i < count; i++) {
+    if (!Hasher::set_backend(backends[i].name)) {
+      assert(!backends[i].supported());
+      continue;
+    }
+    for (size_t len = 0; len <= data.size(); len++) {
+      assert(Hasher().hash(bytes, len) == expected[len]);
+    }
+    assert(Hasher().hash(PARAGRAPH) == paragraph_hex);
+    assert(Truncated().hash(PARAGRAPH) == truncated_hex);
+    std::cout << name << " backend passed: " << backends[i].name << std::endl;
+  }
+  assert(!Hasher::set_backend("no-such-backend"));
+  assert(Hasher::set_backend(original.c_str()));
+}
+
+// Checks hash_many of `Hasher` with every multi-buffer backend against
+// one-at-a-time hashing for a batch of messages of mixed lengths.
+template <typename Hasher, typename Word>
+void test_hash_many(const char* name) {
+  std::vector<std::string> messages;
+  for (size_t i = 0; i < 100; i++) {
+    std::string message;
+    for (size_t j = 0; j < (i * 53) % 300; j++) {
+      message.push_back((char)(i + j * 7));
+    }
+    messages.push_back(message);
+  }
+  std::vector<sha::Segment> inputs;
+  std::vector<typename Hasher::Digest> expected;
+  for (const std::string& message : messages) {
+    inputs.push_back(sha::Segment{message.data(), message.size()});
+    expected.push_back(Hasher().digest(message));
+  }
+
+  std::string original = Hasher::multi_backend().name;
+  size_t count;
+  const sha::MultiBufferBackend<Word>* backends = Hasher::multi_backends(&count);
+  for (size_t i = 0; i < count; i++) {
+    if (!Hasher::set_multi_backend(backends[i].name)) {
+      continue;
+    }
+    std::vector<typename Hasher::Digest> digests(messages.size());
+    Hasher::hash_many(inputs.data(), inputs.size(), digests.data());
+    assert(digests == expected);
+    // A short batch ends in a partially filled group of lanes.
+    std::vector<typename Hasher::Digest> prefix(13);
+    Hasher::hash_many(inputs.data(), prefix.size(), prefix.data());
+    assert(std::equal(prefix.begin(), prefix.end(), expected.begin()));
+    std::cout << name << " hash_many passed: " << backends[i].name << std::endl;
+  }
+  assert(Hasher::set_multi_backend(original.c_str()));
+}
+
+// Checks the one-shot digest, which pads messages of up to two blocks on the
+// stack, against the streaming context around every block boundary.
+template <typename Hasher>
+void test_short_messages(const char* name) {
+  std::string data;
+  for (size_t i = 0; i < 2 * Hasher::BLOCK_SIZE + 2; i++) {
+    data.push_back((char)(i * 29 + 3));
+  }
+  for (size_t len = 0; len <= data.size(); len++) {
+    Hasher context;
+    context.update(data.data(), len / 2);
+    context.update(data.data() + len / 2, len - len / 2);
+    assert(Hasher().digest(data.substr(0, len)) == context.finalize_digest());
+  }
+  std::cout << name << " short messages passed." << std::endl;
+}
+
+// Checks the segmented input of `Hasher` against hashing the joined message,
+// for short and long messages cut at irregular offsets, including empty
+// segments.
+template <typename Hasher>
+void test_segments(const char* name) {
+  std::string data;
+  for (size_t i = 0; i < 1000; i++) {
+    data.push_back((char)(i * 13 + 5));
+  }
+  for (size_t len : {0, 3, 64, 100, 119, 120, 239, 240, 1000}) {
+    std::vector<sha::Segment> segments;
+    size_t offset = 0;
+    for (size_t step = 0; offset < len; step++) {
+      size_t size = std::min(len - offset, (step * 37) % 150);
+      segments.push_back(sha::Segment{data.data() + offset, size});
+      offset += size;
+    }
+    typename Hasher::Digest expected = Hasher().digest(data.substr(0, len));
+    assert(Hasher().digest_segments(segments.data(), segments.size()) ==
+           expected);
+    assert(Hasher().hash_segments(segments.data(), segments.size()) ==
+           sha::AnyDigest(expected).hex());
+    Hasher context;
+    context.update_segments(segments.data(), segments.size());
+    assert(context.finalize_digest() == expected);
+
+    std::vector<struct iovec> iov;
+    for (const sha::Segment& segment : segments) {
+      iov.push_back(iovec{const_cast<void*>(segment.data), segment.size});
+    }
+    assert(Hasher().digest_segments(iov.data(), iov.size()) == expected);
+    sha::Hasher runtime(Hasher::algorithm());
+    runtime.update_segments(iov.data(), iov.size());
+    assert(runtime.finalize_digest() == sha::AnyDigest(expected));
+  }
+  std::cout << name << " segmented input passed." << std::endl;
+}
+
+void test_thread_pool() {
+  sha::ThreadPool pool(4);
+  std::vector<int> runs(10000, 0);
+  std::vector<size_t> per_worker(pool.size(), 0);
+  std::mutex mutex;
+  pool.run(runs.size(), [&](size_t worker, size_t index) {
+    runs[index]++;
+    std::lock_guard<std::mutex> lock(mutex);
+    per_worker[worker]++;
+  });
+  assert(std::count(runs.begin(), runs.end(), 1) == (long)runs.size());
+
+  bool thrown = false;
+  try {
+    pool.run(100, [](size_t, size_t index) {
+      if (index == 42) {
+        throw std::runtime_error("task failed");
+      }
+    });
+  } catch (const std::runtime_error&) {
+    thrown = true;
+  }
+  assert(thrown);
+  std::cout << "ThreadPool test passed" << std::endl;
+}
+
+void test_batch_hasher() {
+  std::vector<std::string> messages;
+  for (size_t i = 0; i < 5000; i++) {
+    std::string message((i * 131) % 700, '\0');
+    for (size_t j = 0; j < message.size(); j++) {
+      message[j] = (char)(i * 3 + j);
+    }
+    messages.push_back(message);
+  }
+  messages.push_back(std::string(300000, 'a'));
+
+  const sha::Algorithm algorithms[] = {sha::Algorithm::SHA256,
+                                       sha::Algorithm::SHA512_224};
+  for (sha::Algorithm algorithm : algorithms) {
+    std::vector<sha::AnyDigest> expected;
+    for (const std::string& message : messages) {
+      expected.push_back(
+          sha::digest(algorithm, message.data(), message.size()));
+    }
+    for (size_t threads = 1; threads <= 4; threads *= 2) {
+      sha::BatchHasher hasher(algorithm, threads);
+      assert(hasher.hash(messages) == expected);
+      assert(hasher.hash(std::vector<std::string>()).empty());
+    }
+    std::cout << sha::algorithm_name(algorithm) << " BatchHasher passed"
+              << std::endl;
+  }
+  assert(sha::digest(sha::Algorithm::SHA256, "", 0).hex() ==
+         "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+}
+
+template <typename Hasher>
+void test_tree_hasher(const char* name) {
+  typedef sha::TreeHasher<Hasher> Tree;
+  std::string message(300, '\0');
+  for (size_t i = 0; i < message.size(); i++) {
+    message[i] = (char)(i * 13);
+  }
+
+  Tree serial(64, 1);
+  typename Tree::Result result = serial.hash(message.data(), message.size());
+  assert(result.leaves.size() == 5);
+  for (size_t i = 0; i < result.leaves.size(); i++) {
+    size_t size = std::min<size_t>(64, message.size() - i * 64);
+    assert(result.leaves[i] == Tree::leaf_digest(&message[i * 64], size));
+  }
+  const typename Tree::Digest* leaves = result.leaves.data();
+  assert(result.root ==
+         Tree::node_digest(
+             Tree::node_digest(Tree::node_digest(leaves[0], leaves[1]),
+                               Tree::node_digest(leaves[2], leaves[3])),
+             leaves[4]));
+
+  Tree parallel(64, 4);
+  assert(parallel.root(message.data(), message.size()) == result.root);
+  assert(Tree::root(result.leaves) == result.root);
+  assert(serial.hash(nullptr, 0).leaves.empty());
+  assert(serial.hash(nullptr, 0).root == Tree::empty_root());
+  assert(Tree::empty_root() == Hasher().digest(""));
+  std::cout << name << " TreeHasher passed" << std::endl;
+}
+
+void test_hash_file() {
+  std::string contents(3 * 1024 * 1024 + 17, '\0');
+  for (size_t i = 0; i < contents.size(); i++) {
+    contents[i] = (char)(i * 7 + i / 4096);
+  }
+  sha::AnyDigest expected = sha::digest(sha::Algorithm::SHA384,
+                                        contents.data(), contents.size());
+
+  char path[] = "/tmp/test_sha_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  assert(write(fd, contents.data(), contents.size()) ==
+         (ssize_t)contents.size());
+  close(fd);
+  assert(sha::hash_file(path, sha::Algorithm::SHA384) == expected);
+
+  // Streamed through a pipe, the same bytes take the read() path.
+  int pipe_fds[2];
+  assert(pipe(pipe_fds) == 0);
+  std::thread writer([&] {
+    for (size_t offset = 0; offset < contents.size(); offset += 65536) {
+      size_t size = std::min<size_t>(65536, contents.size() - offset);
+      assert(write(pipe_fds[1], &contents[offset], size) == (ssize_t)size);
+    }
+    close(pipe_fds[1]);
+  });
+  assert(sha::hash_fd(pipe_fds[0], sha::Algorithm::SHA384) == expected);
+  writer.join();
+  close(pipe_fds[0]);
+
+  fd = open(path, O_WRONLY | O_TRUNC);
+  close(fd);
+  assert(sha::hash_file(path, sha::Algorithm::SHA256).hex() ==
+         "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  unlink(path);
+
+  bool thrown = false;
+  try {
+    sha::hash_file(path, sha::Algorithm::SHA256);
+  } catch (const std::system_error& error) {
+    thrown = error.code() == std::errc::no_such_file_or_directory;
+  }
+  assert(thrown);
+  std::cout << "hash_file test passed" << std::endl;
+}
+
+void test_file_pipeline() {
+  const size_t sizes[] = {0, 1, 4095, 4096, 70000, 1024 * 1024 + 3};
+  std::vector<std::string> paths;
+  std::vector<sha::AnyDigest> expected;
+  for (size_t size : sizes) {
+    std::string contents(size, '\0');
+    for (size_t i = 0; i < size; i++) {
+      contents[i] = (char)(i * 11 + size);
+    }
+    char path[] = "/tmp/test_sha_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    assert(write(fd, contents.data(), size) == (ssize_t)size);
+    close(fd);
+    paths.push_back(path);
+    expected.push_back(
+        sha::digest(sha::Algorithm::SHA256, contents.data(), size));
+  }
+  paths.push_back("/tmp/test_sha_missing");
+  paths.push_back("/dev/null");
+  expected.push_back(sha::AnyDigest());
+  expected.push_back(expected[0]);
+
+  // Small buffers and queues make reads of one file complete out of order
+  // and files wait for free buffers.
+  for (int mode = 0; mode < 4; mode++) {
+    sha::FilePipelineOptions options;
+    options.threads = 1 + mode % 2 * 2;
+    options.io_uring = mode < 2;
+    options.direct_io = mode != 1;
+    options.queue_depth = mode == 0 ? 3 : 8;
+    options.buffer_size = 4096;
+    sha::FilePipeline pipeline(sha::Algorithm::SHA256, options);
+    assert(pipeline.threads() == options.threads);
+    if (!options.io_uring) {
+      assert(!pipeline.uses_io_uring());
+    }
+
+    std::vector<sha::FileResult> results = pipeline.hash(paths);
+    assert(results.size() == paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+      assert(results[i].digest == expected[i]);
+      assert(!results[i].error == (i != 6));
+    }
+    assert(results[6].error ==
+           std::errc::no_such_file_or_directory);
+
+    std::vector<bool> seen(paths.size(), false);
+    pipeline.hash(paths, [&](size_t index, const sha::FileResult& result) {
+      assert(!seen[index]);
+      seen[index] = true;
+      assert(result.digest == expected[index]);
+    });
+    assert(std::count(seen.begin(), seen.end(), true) == (long)paths.size());
+
+    std::future<std::vector<sha::FileResult>> future =
+        pipeline.hash_async(paths);
+    assert(future.get()[5].digest == expected[5]);
+
+    // A throwing callback ends the batch: nothing is reported after it.
+    std::vector<std::string> many;
+    for (int i = 0; i < 16; i++) {
+      many.insert(many.end(), paths.begin(), paths.end());
+    }
+    size_t calls = 0;
+    bool stopped = false;
+    try {
+      pipeline.hash(many, [&](size_t, const sha::FileResult&) {
+        calls++;
+        throw std::runtime_error("stop");
+      });
+    } catch (const std::runtime_error&) {
+      stopped = true;
+    }
+    assert(stopped && calls == 1);
+    assert(pipeline.hash(paths)[5].digest == expected[5]);
+  }
+
+  bool thrown = false;
+  try {
+    sha::FilePipelineOptions options;
+    options.queue_depth = 0;
+    sha::FilePipeline pipeline(sha::Algorithm::SHA256, options);
+  } catch (const std::invalid_argument&) {
+    thrown = true;
+  }
+  assert(thrown);
+  for (size_t i = 0; i < 6; i++) {
+    unlink(paths[i].c_str());
+  }
+  std::cout << "FilePipeline test passed ("
+            << (sha::FilePipeline(sha::Algorithm::SHA256).uses_io_uring()
+                    ? "io_uring"
+                    : "pread")
+            << ")" << std::endl;
+}
+
+void test_caching_hasher() {
+  typedef sha::CachingHasher<sha::SHA256> Cache;
+  std::vector<std::string> inputs;
+  for (size_t i = 0; i < 64; i++) {
+    inputs.push_back(std::string(100 + i, (char)i));
+  }
+  // Empty and NUL inputs are cached like any other.
+  inputs.push_back("");
+  inputs.push_back(std::string(1, '\0'));
+
+  Cache cache(1 << 20, 4);
+  for (int round = 0; round < 3; round++) {
+    for (const std::string& input : inputs) {
+      assert(cache.digest(input) == sha::SHA256().digest(input));
+      assert(cache.hash(input) == sha::SHA256().hash(input));
+    }
+  }
+  sha::CacheStats stats = cache.stats();
+  assert(stats.misses == inputs.size());
+  assert(stats.hits == 6 * inputs.size() - stats.misses);
+  assert(stats.evictions == 0);
+  assert(stats.entries == inputs.size());
+
+  // A budget for about four entries per shard keeps only recent inputs.
+  Cache small(2 * 4 * (200 + Cache::ENTRY_OVERHEAD), 2);
+  for (const std::string& input : inputs) {
+    assert(small.digest(input) == sha::SHA256().digest(input));
+  }
+  stats = small.stats();
+  assert(stats.bytes <= small.max_bytes());
+  assert(stats.evictions == inputs.size() - stats.entries);
+  assert(small.digest(inputs.back()) == sha::SHA256().digest(inputs.back()));
+  assert(small.stats().hits == 1);
+
+  // Inputs larger than a shard's budget are hashed but not cached.
+  std::string large(small.max_bytes(), 'x');
+  assert(small.digest(large) == sha::SHA256().digest(large));
+  assert(small.stats().entries == stats.entries);
+  small.clear();
+  assert(small.stats().entries == 0 && small.stats().bytes == 0);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&cache, &inputs, t] {
+      for (size_t i = 0; i < 1000; i++) {
+        const std::string& input = inputs[(i * 7 + t) % inputs.size()];
+        assert(cache.digest(input) == sha::SHA256().digest(input));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  assert(cache.stats().misses == inputs.size());
+  std::cout << "CachingHasher test passed" << std::endl;
+}
+
+void test_stats() {
+  sha::reset_stats();
+  sha::SHA256().hash("abc");
+  sha::SHA256 context;
+  std::string thousand(1000, 'a');
+  context.update(thousand.data(), thousand.size());
+  context.finalize();
+  sha::SHA512().digest(std::string(200, 'b'));
+  sha::StatsSnapshot snapshot = sha::stats_snapshot();
+  const sha::AlgorithmStats& sha256 = snapshot[sha::Algorithm::SHA256];
+  const sha::AlgorithmStats& sha512 = snapshot[sha::Algorithm::SHA512];
+  std::string text = snapshot.prometheus();
+  assert(text.find("# TYPE sha_message_bytes histogram") != std::string::npos);
+  if (sha::STATS_ENABLED) {
+    assert(sha256.bytes == 1003 && sha256.messages == 2);
+    // One block for "abc" and 16 for 1000 bytes plus padding.
+    assert(sha256.blocks == 17);
+    assert(sha256.calls[0] == 1 && sha256.calls[2] == 1);
+    assert(sha256.message_bytes == 1003);
+    assert(sha256.compress_cycles > 0 && sha256.hex_cycles > 0);
+    assert(sha512.bytes == 200 && sha512.blocks == 2 && sha512.calls[0] == 0 &&
+           sha512.calls[1] == 1);
+    assert(snapshot[sha::Algorithm::SHA224].bytes == 0);
+    assert(text.find("sha_bytes_total{algorithm=\"SHA-256\"} 1003\n") !=
+           std::string::npos);
+    assert(text.find("sha_message_bytes_bucket{algorithm=\"SHA-256\","
+                     "le=\"1024\"} 2\n") != std::string::npos);
+
+    // Threads that have exited still count.
+    std::thread([] { sha::SHA384().hash(std::string(10, 'c')); }).join();
+    assert(sha::stats_snapshot()[sha::Algorithm::SHA384].bytes == 10);
+  } else {
+    assert(sha256.bytes == 0 && sha256.blocks == 0 && sha256.messages == 0);
+  }
+  sha::reset_stats();
+  assert(sha::stats_snapshot()[sha::Algorithm::SHA256].bytes == 0);
+  std::cout << "Statistics test passed" << std::endl;
+}
+
+void test_runtime_hasher() {
+  sha::Hasher context(sha::Algorithm::SHA512_256);
+  context.update("abc", 3);
+  sha::Hasher copy = context;
+  context.update("def", 3);
+  assert(copy.finalize() == sha::SHA512_256().hash("abc"));
+  assert(context.finalize() == sha::SHA512_256().hash("abcdef"));
+  // Finalizing resets the context for the next message.
+  context.update("abc", 3);
+  assert(context.finalize() == sha::SHA512_256().hash("abc"));
+  assert(context.finalize_digest().size == 32);
+  std::cout << "Hasher test passed" << std::endl;
+}
+
+void test_verify() {
+  const std::string hex = sha::SHA256().hash(PARAGRAPH);
+  const sha::SHA256::Digest digest = sha::SHA256().digest(PARAGRAPH);
+  std::string upper = hex;
+  std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+  sha::SHA256 hasher;
+  assert(hasher.verify(PARAGRAPH, digest));
+  assert(hasher.verify(PARAGRAPH, hex));
+  assert(hasher.verify(PARAGRAPH, upper));
+  assert(!hasher.verify(std::string(PARAGRAPH) + ".", digest));
+  sha::SHA256::Digest flipped = digest;
+  flipped[31] ^= 1;
+  assert(!hasher.verify(PARAGRAPH, flipped));
+  assert(!hasher.verify(PARAGRAPH, hex.substr(1)));
+  assert(!hasher.verify(PARAGRAPH, "g" + hex.substr(1)));
+
+  uint8_t bytes[3];
+  assert(sha::hex_decode("00fFa7", 6, bytes) && bytes[0] == 0 &&
+         bytes[1] == 0xff && bytes[2] == 0xa7);
+  assert(!sha::hex_decode("0", 1, bytes) && !sha::hex_decode("0x", 2, bytes));
+  assert(sha::constant_time_equal("abcdefghij", "abcdefghij", 10));
+  assert(!sha::constant_time_equal("abcdefghij", "abcdefghiJ", 10));
+  assert(sha::constant_time_equal("", "", 0));
+
+  sha::HMAC<sha::SHA512> mac("key");
+  std::string tag = mac.hash(PARAGRAPH);
+  assert(mac.verify(PARAGRAPH, strlen(PARAGRAPH), tag));
+  assert(mac.verify(PARAGRAPH, strlen(PARAGRAPH), mac.digest(PARAGRAPH)));
+  assert(!mac.verify(PARAGRAPH, strlen(PARAGRAPH) - 1, tag));
+
+  // A streamed message with a known length, then one that overruns it and
+  // one that stops short.
+  const size_t len = strlen(PARAGRAPH);
+  sha::Verifier<sha::SHA256> verifier(hex, len);
+  verifier.update(PARAGRAPH, 100);
+  verifier.update(PARAGRAPH + 100, len - 100);
+  assert(!verifier.failed() && verifier.finalize());
+  verifier.update(PARAGRAPH, len);
+  verifier.update("x", 1);
+  assert(verifier.failed() && !verifier.finalize());
+  verifier.update(PARAGRAPH, len - 1);
+  assert(!verifier.failed() && !verifier.finalize());
+
+  sha::Verifier<sha::SHA256> any_length(digest);
+  any_length.update(PARAGRAPH, len);
+  assert(any_length.finalize());
+  sha::Verifier<sha::SHA256> malformed(hex.substr(2));
+  assert(malformed.failed());
+  malformed.update(PARAGRAPH, len);
+  assert(!malformed.finalize() && malformed.failed());
+  std::cout << "Verification test passed" << std::endl;
+}
+
+void test_hmac() {
+  // RFC 4231 test cases 1, 2 and 6; the key of case 6 is longer than a block.
+  const std::string keys[] = {std::string(20, '\x0b'), "Jefe",
+                              std::string(131, '\xaa')};
+  const std::string messages[] = {
+      "Hi There", "what do ya want for nothing?",
+      "Test Using Larger Than Block-Size Key - Hash Key First"};
+  const char* sha256_macs[] = {
+      "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7",
+      "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843",
+      "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54"};
+  const char* sha224_macs[] = {
+      "896fb1128abbdf196832107cd49df33f47b4b1169912ba4f53684b22",
+      "a30e01098bc6dbbf45690f3a7e9e6d0f8bbea2a39e6148008fd05e44",
+      "95e9a0db962095adaebe9b2d6f0dbce2d499f112f2d2b7273fa6870e"};
+  const char* sha384_macs[] = {
+      "afd03944d84895626b0825f4ab46907f15f9dadbe4101ec682aa034c7cebc59cfaea9ea9"
+      "076ede7f4af152e8b2fa9cb6",
+      "af45d2e376484031617f78d2b58a6b1b9c7ef464f5a01b47e42ec3736322445e8e2240ca"
+      "5e69e2c78b3239ecfab21649",
+      "4ece084485813e9088d2c63a041bc5b44f9ef1012a2b588f3cd11f05033ac4c60c2ef6ab"
+      "4030fe8296248df163f44952"};
+  const char* sha512_macs[] = {
+      "87aa7cdea5ef619d4ff0b4241a1d6cb02379f4e2ce4ec2787ad0b30545e17cdedaa833b7"
+      "d6b8a702038b274eaea3f4e4be9d914eeb61f1702e696c203a126854",
+      "164b7a7bfcf819e2e395fbe73b56e0a387bd64222e831fd610270cd7ea2505549758bf75"
+      "c05a994a6d034f65f8f0e6fdcaeab1a34d4a6b4b636e070a38bce737",
+      "80b24263c7c1a3ebb71493c1dd7be8b49b46d1f41b4aeec1121b013783f8f3526b56d037"
+      "e05f2598bd0fd2215d6a1e5295e64f73f63f0aec8b915a985d786598"};
+  for (int i = 0; i < 3; i++) {
+    assert(sha::HMAC<sha::SHA256>(keys[i]).hash(messages[i]) == sha256_macs[i]);
+    assert(sha::HMAC<sha::SHA224>(keys[i]).hash(messages[i]) == sha224_macs[i]);
+    assert(sha::HMAC<sha::SHA384>(keys[i]).hash(messages[i]) == sha384_macs[i]);
+    assert(sha::HMAC<sha::SHA512>(keys[i]).hash(messages[i]) == sha512_macs[i]);
+  }
+
+  // The cached pad states are reused across consecutive streamed messages.
+  sha::HMAC<sha::SHA256> mac(keys[1]);
+  for (int round = 0; round < 2; round++) {
+    mac.update("what do ya want ", 16);
+    mac.update("for nothing?", 12);
+    assert(mac.finalize() == sha256_macs[1]);
+  }
+  std::cout << "HMAC test passed" << std::endl;
+}
+
+template <typename Hasher, typename Other>
+void test_export_state(const char* name) {
+  std::string message(PARAGRAPH);
+  for (size_t split = 0; split < 300; split += 37) {
+    Hasher prefix;
+    prefix.update(message.data(), split);
+    typename Hasher::State state = prefix.export_state();
+
+    // Resume from a serialized copy, as another process would.
+    typename Hasher::State restored;
+    assert(restored.deserialize(state.serialize()));
+    Hasher resumed;
+    assert(resumed.import_state(restored));
+    resumed.update(message.data() + split, message.size() - split);
+    assert(resumed.finalize() == Hasher().hash(message));
+
+    // A state of another algorithm with the same word size is rejected.
+    assert(!Other().import_state(state));
+  }
+  typename Hasher::State state;
+  assert(!state.deserialize("sha2", 4));
+  assert(!state.deserialize(std::string(40, '\0')));
+  std::cout << name << " export_state test passed" << std::endl;
+}
+
+#ifdef SHA_HAS_STRING_VIEW
+// Digests computed by the compiler.
+constexpr sha::SHA256::Digest ABC_SHA256 =
+    sha::SHA256::digest(std::string_view("abc"));
+static_assert(ABC_SHA256[0] == 0xba && ABC_SHA256[31] == 0xad,
+              "constexpr SHA-256 of \"abc\"");
+constexpr sha::SHA384::Digest ABC_SHA384 =
+    sha::SHA384::digest(std::string_view("abc"));
+static_assert(ABC_SHA384[0] == 0xcb && ABC_SHA384[47] == 0xa7,
+              "constexpr SHA-384 of \"abc\"");
+
+void test_constexpr_digest() {
+  std::string message(PARAGRAPH);
+  for (size_t len = 0; len <= 300; len++) {
+    std::string_view view(message.data(), len);
+    assert((sha::detail::constexpr_digest<32>(view, sha::CONST_SHA256_H) ==
+            sha::SHA256().digest(message.substr(0, len))));
+    assert((sha::detail::constexpr_digest<28>(view, sha::CONST_SHA224_H) ==
+            sha::SHA224().digest(message.substr(0, len))));
+    assert((sha::detail::constexpr_digest<64>(view, sha::CONST_SHA512_H) ==
+            sha::SHA512().digest(message.substr(0, len))));
+    assert((sha::detail::constexpr_digest<32>(view, sha::CONST_SHA512_256_H) ==
+            sha::SHA512_256().digest(message.substr(0, len))));
+  }
+  assert(sha::SHA256().digest("abc") == ABC_SHA256);
+  assert(sha::SHA384().digest("abc") == ABC_SHA384);
+  std::cout << "constexpr digest test passed" << std::endl;
+}
+#endif
+
+// Computes the RFC 6962 root of leaves [begin, end) by its recursive
+// definition, which splits at the largest power of two below the size.
+template <typename Hasher>
+typename Hasher::Digest reference_root(
+    const std::vector<typename Hasher::Digest>& leaves, size_t begin,
+    size_t end) {
+  if (end - begin == 1) {
+    return leaves[begin];
+  }
+  size_t split = 1;
+  while (2 * split < end - begin) {
+    split *= 2;
+  }
+  return sha::TreeHasher<Hasher>::node_digest(
+      reference_root<Hasher>(leaves, begin, begin + split),
+      reference_root<Hasher>(leaves, begin + split, end));
+}
+
+template <typename Hasher>
+void test_merkle_tree(const char* name) {
+  typedef sha::MerkleTree<Hasher> Merkle;
+  typedef typename Hasher::Digest Digest;
+  const size_t counts[] = {1, 2, 3, 5, 8, 13, 64, 129, 300};
+  for (size_t count : counts) {
+    std::vector<Digest> leaves(count);
+    for (size_t i = 0; i < count; i++) {
+      uint64_t value = i * 7919;
+      leaves[i] = Merkle::Tree::leaf_digest(&value, sizeof(value));
+    }
+    Merkle tree(leaves);
+    assert(tree.size() == count);
+    assert(tree.root() == reference_root<Hasher>(leaves, 0, count));
+    assert(tree.root() == Merkle::Tree::root(leaves));
+
+    for (size_t i = 0; i < count; i++) {
+      std::vector<Digest> proof = tree.proof(i);
+      assert(Merkle::verify(leaves[i], i, count, proof, tree.root()));
+      assert(!Merkle::verify(leaves[(i + 1) % count], i, count, proof,
+                             tree.root()) ||
+             count == 1);
+      if ((i ^ 1) < count) {
+        assert(!Merkle::verify(leaves[i], i ^ 1, count, proof, tree.root()));
+      }
+      if (!proof.empty()) {
+        proof[0][0] ^= 1;
+        assert(!Merkle::verify(leaves[i], i, count, proof, tree.root()));
+      }
+    }
+    assert(!Merkle::verify(leaves[0], count, count, tree.proof(0),
+                           tree.root()));
+
+    // Changing leaves one at a time gives the tree built from scratch.
+    for (size_t i = 0; i < count; i += 1 + count / 4) {
+      leaves[i][1] ^= 0x5a;
+      tree.update_leaf(i, leaves[i]);
+      assert(tree.leaf(i) == leaves[i]);
+      assert(tree.root() == Merkle(leaves).root());
+    }
+    tree.update_leaf(count - 1, "entry", 5);
+    leaves[count - 1] = Merkle::Tree::leaf_digest("entry", 5);
+    assert(tree.root() == reference_root<Hasher>(leaves, 0, count));
+
+    bool threw = false;
+    try {
+      tree.proof(count);
+    } catch (const std::out_of_range&) {
+      threw = true;
+    }
+    assert(threw);
+  }
+
+  sha::Segment data[] = {{reinterpret_cast<const uint8_t*>("a"), 1},
+                         {reinterpret_cast<const uint8_t*>("bc"), 2},
+                         {nullptr, 0}};
+  Merkle from_data = Merkle::from_data(data, 3);
+  assert(from_data.leaf(1) == Merkle::Tree::leaf_digest("bc", 2));
+  assert(Merkle().size() == 0);
+  assert(Merkle().root() == Hasher().digest(""));
+  assert(Merkle::Tree::root(std::vector<Digest>()) == Merkle().root());
+  std::cout << name << " MerkleTree passed" << std::endl;
+}
+
+#ifdef SHA_HAS_EXECUTION
+void test_hash_all() {
+  // Mostly small payloads with a few large ones, so the chunks are cut by
+  // bytes rather than by count.
+  std::vector<std::string> payloads(3000);
+  for (size_t i = 0; i < payloads.size(); i++) {
+    size_t size = i % 1000 == 7 ? 300000 + i : i % 200;
+    payloads[i].assign(size, (char)(i * 31));
+  }
+  std::vector<sha::SHA256::Digest> expected(payloads.size());
+  for (size_t i = 0; i < payloads.size(); i++) {
+    expected[i] = sha::SHA256().digest(payloads[i]);
+  }
+
+  std::vector<sha::SHA256::Digest> digests(payloads.size());
+  sha::hash_all<sha::SHA256>(std::execution::par, payloads.begin(),
+                             payloads.end(), digests.begin());
+  assert(digests == expected);
+  std::fill(digests.begin(), digests.end(), sha::SHA256::Digest());
+  sha::hash_all<sha::SHA256>(std::execution::par_unseq, payloads.begin(),
+                             payloads.end(), digests.begin());
+  assert(digests == expected);
+  std::fill(digests.begin(), digests.end(), sha::SHA256::Digest());
+  sha::hash_all<sha::SHA256>(std::execution::seq, payloads.cbegin(),
+                             payloads.cend(), digests.begin());
+  assert(digests == expected);
+
+  std::vector<std::string_view> views(payloads.begin(), payloads.end());
+  std::vector<sha::AnyDigest> any(views.size());
+  sha::hash_all<sha::SHA384>(std::execution::par, views.begin(), views.end(),
+                             any.begin());
+  for (size_t i = 0; i < views.size(); i += 97) {
+    assert(any[i] == sha::AnyDigest(sha::SHA384().digest(payloads[i])));
+  }
+  sha::hash_all<sha::SHA256>(std::execution::par, views.begin(),
+                             views.begin(), any.begin());
+  std::cout << "hash_all test passed" << std::endl;
+}
+#endif
+
 int main() {
   test_sha512();
   test_sha384();
@@ -71,6 +1069,84 @@ int main() {
   test_sha512_256();
   test_sha224();
   test_sha512_224();
+  test_sha256_streaming();
+  test_sha384_streaming();
+  test_binary_input();
+  test_raw_digest();
+  test_caller_buffers();
+  test_backends<sha::SHA256, sha::SHA224, uint32_t>(
+      "SHA-256",
+      "32ce66b1c62d176f259d153156d1cb1e80349ac08f272d6a3e0498623b67c81b",
+      "562ade37aa31cebfa14b8eb2e5a830c1de2fca5e69513bfe94eeeef6");
+  test_backends<sha::SHA512, sha::SHA384, uint64_t>(
+      "SHA-512",
+      "c5277b97cf1fee58d398f8a112c156fdf5e0fb07f6e2a4222277fdf316412d84"
+      "da29533998b58b8f1fff4100d37a4055c1a36414e41308ffc1d70dc7602d27e0",
+      "d49233f7fed6cb61d556934e11ea9c82b86a9e4bfcd4aa48ba2140b9cf85ae0daf414a8d"
+      "68aa7b4a9b752d8d9be6a041");
+  test_hash_many<sha::SHA256, uint32_t>("SHA-256");
+  test_hash_many<sha::SHA224, uint32_t>("SHA-224");
+  test_hash_many<sha::SHA512, uint64_t>("SHA-512");
+  test_hash_many<sha::SHA384, uint64_t>("SHA-384");
+  test_fixed_size<sha::SHA256, uint32_t>("SHA-256");
+  test_fixed_size<sha::SHA224, uint32_t>("SHA-224");
+  test_fixed_size<sha::SHA512, uint64_t>("SHA-512");
+  test_fixed_size<sha::SHA384, uint64_t>("SHA-384");
+  // SHA-256d of "hello".
+  assert(sha::AnyDigest(sha::SHA256::digest_double(
+             reinterpret_cast<const uint8_t*>("hello"), 5))
+             .hex() ==
+         "9595c9df90075148eb06860365df33584b75bff782a510c6cd4883a419833d50");
+  test_short_messages<sha::SHA256>("SHA-256");
+  test_short_messages<sha::SHA512_224>("SHA-512/224");
+  test_segments<sha::SHA256>("SHA-256");
+  test_segments<sha::SHA384>("SHA-384");
+  test_thread_pool();
+  test_batch_hasher();
+#ifdef SHA_HAS_EXECUTION
+  test_hash_all();
+#endif
+  test_tree_hasher<sha::SHA256>("SHA-256");
+  test_tree_hasher<sha::SHA512>("SHA-512");
+  // RFC 6962 leaf hash of the empty leaf.
+  sha::SHA256::Digest empty_leaf = sha::TreeHasher<sha::SHA256>::leaf_digest(
+      nullptr, 0);
+  assert(sha::AnyDigest(empty_leaf).hex() ==
+         "6e340b9cffb37a989ca544e6bb780a2c78901d3fb33738768511a30617afa01d");
+  // RFC 6962 root of the empty tree, the digest of the empty string.
+  assert(sha::AnyDigest(sha::MerkleTree<sha::SHA256>().root()).hex() ==
+         "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  test_merkle_tree<sha::SHA256>("SHA-256");
+  test_merkle_tree<sha::SHA512>("SHA-512");
+  test_merkle_tree<sha::SHA224>("SHA-224");
+  // The root of the eight-leaf test tree of the RFC 6962 reference code.
+  {
+    const std::string inputs[] = {
+        std::string(), std::string(1, '\0'), "\x10", "\x20\x21", "\x30\x31",
+        "\x40\x41\x42\x43", "\x50\x51\x52\x53\x54\x55\x56\x57",
+        "\x60\x61\x62\x63\x64\x65\x66\x67\x68\x69\x6a\x6b\x6c\x6d\x6e\x6f"};
+    std::vector<sha::SHA256::Digest> leaves;
+    for (const std::string& input : inputs) {
+      leaves.push_back(sha::TreeHasher<sha::SHA256>::leaf_digest(
+          input.data(), input.size()));
+    }
+    assert(sha::AnyDigest(sha::MerkleTree<sha::SHA256>(leaves).root()).hex() ==
+           "5dc9da79a70659a9ad559cb701ded9a2ab9d823aad2f4960cfe370eff4604328");
+  }
+  test_runtime_hasher();
+  test_caching_hasher();
+  test_stats();
+  test_hash_file();
+  test_file_pipeline();
+  test_hmac();
+  test_verify();
+  test_export_state<sha::SHA256, sha::SHA224>("SHA-256");
+  test_export_state<sha::SHA224, sha::SHA256>("SHA-224");
+  test_export_state<sha::SHA512_256, sha::SHA512>("SHA-512/256");
+  test_export_state<sha::SHA384, sha::SHA512_224>("SHA-384");
+#ifdef SHA_HAS_STRING_VIEW
+  test_constexpr_digest();
+#endif
   std::cout << "All test passed successfully." << std::endl;
   return 0;
 }
@@ -0,0 +1,396 @@
+/*
+ * shasum.cpp
+ *
+ * A command-line tool in the style of coreutils' sha256sum and Perl's shasum,
+ * built on the SHA-2 library. It prints or checks the digests of files:
+ *
+ *   shasum [-a ALGORITHM] [-j JOBS] [-b | -t] [FILE]...
+ *   shasum [-a ALGORITHM] [-j JOBS] -c [--quiet] [--status] [MANIFEST]...
+ *
+ * With one job, files are hashed one after another through `sha::hash_file`
+ * (memory-mapped where possible); with more, they are hashed concurrently by
+ * a `sha::FilePipeline`. Output lines always follow the order of the
+ * arguments. A FILE of "-", or no FILE at all, reads standard input.
+ *
+ * This file relies on the `sha_file.h` and `sha_pipeline.h` headers and
+ * requires compilation with C++11 or later.
+ */
+
+#include <unistd.h>
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "sha.h"
+#include "sha_file.h"
+#include "sha_pipeline.h"
+
+namespace {
+
+const char* PROGRAM = "shasum";
+
+// Command line settings.
+struct Options {
+  sha::Algorithm algorithm = sha::Algorithm::SHA256;
+  bool algorithm_set = false;
+  size_t jobs = 1;
+  bool check = false;
+  bool binary = false;
+  bool quiet = false;   // --check: do not print OK lines.
+  bool status = false;  // --check: print nothing, only set the exit code.
+  std::vector<std::string> files;
+};
+
+// Called with each file's position and result, in input order.
+typedef std::function<void(size_t index, const sha::FileResult& result)> Emit;
+
+// Parses the -a argument: 224, 256, 384, 512, 512224 or 512256.
+bool parse_algorithm(const std::string& name, sha::Algorithm* algorithm) {
+  static const struct {
+    const char* name;
+    sha::Algorithm algorithm;
+  } NAMES[] = {
+      {"224", sha::Algorithm::SHA224},
+      {"256", sha::Algorithm::SHA256},
+      {"384", sha::Algorithm::SHA384},
+      {"512", sha::Algorithm::SHA512},
+      {"512224", sha::Algorithm::SHA512_224},
+      {"512256", sha::Algorithm::SHA512_256},
+  };
+  for (const auto& entry : NAMES) {
+    if (name == entry.name) {
+      *algorithm = entry.algorithm;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Hashes standard input.
+sha::FileResult hash_stdin(sha::Algorithm algorithm) {
+  sha::FileResult result;
+  try {
+    result.digest = sha::hash_fd(STDIN_FILENO, algorithm);
+  } catch (const std::system_error& error) {
+    result.error = error.code();
+  }
+  return result;
+}
+
+// Hashes the files at `paths` with `jobs` workers and passes the results to
+// `emit` in the order of `paths`. A path of "-" stands for standard input,
+// which is hashed first.
+void hash_paths(const std::vector<std::string>& paths,
+                sha::Algorithm algorithm, size_t jobs, const Emit& emit) {
+  std::vector<sha::FileResult> results(paths.size());
+  std::vector<bool> done(paths.size(), false);
+  std::vector<std::string> files;
+  std::vector<size_t> positions;
+  for (size_t i = 0; i < paths.size(); i++) {
+    if (paths[i] == "-") {
+      results[i] = hash_stdin(algorithm);
+      done[i] = true;
+    } else {
+      files.push_back(paths[i]);
+      positions.push_back(i);
+    }
+  }
+
+  // Emits the longest prefix of finished results that has not been emitted.
+  size_t next = 0;
+  auto flush = [&]() {
+    for (; next < paths.size() && done[next]; next++) {
+      emit(next, results[next]);
+    }
+  };
+
+  if (jobs <= 1) {
+    for (size_t i = 0; i < files.size(); i++) {
+      sha::FileResult& result = results[positions[i]];
+      try {
+        result.digest = sha::hash_file(files[i], algorithm);
+      } catch (const std::system_error& error) {
+        result.error = error.code();
+      }
+      done[positions[i]] = true;
+      flush();
+    }
+  } else if (!files.empty()) {
+    sha::FilePipelineOptions options;
+    options.threads = jobs;
+    sha::FilePipeline pipeline(algorithm, options);
+    pipeline.hash(files, [&](size_t index, const sha::FileResult& result) {
+      results[positions[index]] = result;
+      done[positions[index]] = true;
+      flush();
+    });
+  }
+  flush();
+}
+
+// Prints the digest line of each file. Returns the exit status.
+int print_digests(const Options& options) {
+  int status = 0;
+  hash_paths(options.files, options.algorithm, options.jobs,
+             [&](size_t index, const sha::FileResult& result) {
+               const std::string& path = options.files[index];
+               if (result.error) {
+                 std::cerr << PROGRAM << ": " << path << ": "
+                           << result.error.message() << std::endl;
+                 status = 1;
+                 return;
+               }
+               std::cout << result.digest.hex()
+                         << (options.binary ? " *" : "  ") << path << '\n';
+             });
+  return status;
+}
+
+// A line of a manifest: the expected digest of a file.
+struct Entry {
+  std::string hex;
+  std::string path;
+  sha::Algorithm algorithm;
+};
+
+// Parses a manifest line "<hex>  <path>" or "<hex> *<path>". Without -a, the
+// algorithm follows from the digest length, as in shasum: 56, 64, 96 and 128
+// hex digits select SHA-224, SHA-256, SHA-384 and SHA-512.
+bool parse_entry(const std::string& line, const Options& options,
+                 Entry* entry) {
+  size_t space = line.find(' ');
+  if (space == std::string::npos || space == 0 || space + 2 > line.size() ||
+      (line[space + 1] != ' ' && line[space + 1] != '*')) {
+    return false;
+  }
+  entry->hex = line.substr(0, space);
+  entry->path = line.substr(space + 2);
+  for (char& c : entry->hex) {
+    if (!std::isxdigit(static_cast<unsigned char>(c))) {
+      return false;
+    }
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  if (options.algorithm_set) {
+    entry->algorithm = options.algorithm;
+  } else if (entry->hex.size() == 56) {
+    entry->algorithm = sha::Algorithm::SHA224;
+  } else if (entry->hex.size() == 64) {
+    entry->algorithm = sha::Algorithm::SHA256;
+  } else if (entry->hex.size() == 96) {
+    entry->algorithm = sha::Algorithm::SHA384;
+  } else if (entry->hex.size() == 128) {
+    entry->algorithm = sha::Algorithm::SHA512;
+  } else {
+    return false;
+  }
+  return entry->hex.size() == 2 * sha::digest_size(entry->algorithm) &&
+         !entry->path.empty();
+}
+
+// Verifies the files listed in each manifest. Returns the exit status.
+int check_manifests(const Options& options) {
+  std::vector<Entry> entries;
+  size_t malformed = 0;
+  for (const std::string& manifest : options.files) {
+    std::ifstream file;
+    std::istream* input = &std::cin;
+    if (manifest != "-") {
+      file.open(manifest);
+      if (!file) {
+        std::cerr << PROGRAM << ": " << manifest << ": "
+                  << std::strerror(errno) << std::endl;
+        return 1;
+      }
+      input = &file;
+    }
+    for (std::string line; std::getline(*input, line);) {
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      Entry entry;
+      if (parse_entry(line, options, &entry)) {
+        entries.push_back(entry);
+      } else if (!line.empty()) {
+        malformed++;
+      }
+    }
+  }
+
+  // Hash the entries of each algorithm together, then report in order.
+  std::vector<sha::FileResult> results(entries.size());
+  const sha::Algorithm algorithms[] = {
+      sha::Algorithm::SHA224,     sha::Algorithm::SHA256,
+      sha::Algorithm::SHA384,     sha::Algorithm::SHA512,
+      sha::Algorithm::SHA512_224, sha::Algorithm::SHA512_256};
+  for (sha::Algorithm algorithm : algorithms) {
+    std::vector<std::string> paths;
+    std::vector<size_t> positions;
+    for (size_t i = 0; i < entries.size(); i++) {
+      if (entries[i].algorithm == algorithm) {
+        paths.push_back(entries[i].path);
+        positions.push_back(i);
+      }
+    }
+    hash_paths(paths, algorithm, options.jobs,
+               [&](size_t index, const sha::FileResult& result) {
+                 results[positions[index]] = result;
+               });
+  }
+
+  size_t unreadable = 0;
+  size_t mismatched = 0;
+  for (size_t i = 0; i < entries.size(); i++) {
+    const char* verdict = "OK";
+    if (results[i].error) {
+      if (!options.status) {
+        std::cerr << PROGRAM << ": " << entries[i].path << ": "
+                  << results[i].error.message() << std::endl;
+      }
+      verdict = "FAILED open or read";
+      unreadable++;
+    } else if (results[i].digest.hex() != entries[i].hex) {
+      verdict = "FAILED";
+      mismatched++;
+    } else if (options.quiet) {
+      continue;
+    }
+    if (!options.status) {
+      std::cout << entries[i].path << ": " << verdict << '\n';
+    }
+  }
+
+  if (!options.status) {
+    std::cout.flush();
+    if (malformed != 0) {
+      std::cerr << PROGRAM << ": WARNING: " << malformed
+                << (malformed == 1 ? " line is" : " lines are")
+                << " improperly formatted" << std::endl;
+    }
+    if (unreadable != 0) {
+      std::cerr << PROGRAM << ": WARNING: " << unreadable
+                << (unreadable == 1 ? " listed file" : " listed files")
+                << " could not be read" << std::endl;
+    }
+    if (mismatched != 0) {
+      std::cerr << PROGRAM << ": WARNING: " << mismatched
+                << (mismatched == 1 ? " computed checksum did"
+                                    : " computed checksums did")
+                << " NOT match" << std::endl;
+    }
+  }
+  if (entries.empty()) {
+    if (!options.status) {
+      std::cerr << PROGRAM << ": no properly formatted checksum lines found"
+                << std::endl;
+    }
+    return 1;
+  }
+  return unreadable == 0 && mismatched == 0 ? 0 : 1;
+}
+
+void usage(std::ostream& out) {
+  out << "Usage: " << PROGRAM << " [OPTION]... [FILE]...\n"
+      << "Print or check SHA-2 checksums. With no FILE, or when FILE is -,\n"
+      << "read standard input.\n\n"
+      << "  -a, --algorithm ALG  224, 256 (default), 384, 512, 512224 or\n"
+      << "                       512256\n"
+      << "  -b, --binary         mark lines with '*' (no effect on the digest)\n"
+      << "  -t, --text           mark lines with ' ' (default)\n"
+      << "  -c, --check          read checksums from the FILEs and check them\n"
+      << "  -j, --jobs N         hash up to N files in parallel (default 1)\n"
+      << "      --quiet          --check: don't print OK for each file\n"
+      << "      --status         --check: print nothing, use the exit code\n"
+      << "  -h, --help           show this help\n";
+}
+
+// Parses the command line into `options`. Returns false on a usage error.
+bool parse_options(int argc, char** argv, Options* options) {
+  bool literal = false;  // After "--", every argument is a file.
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (literal || arg == "-" || arg[0] != '-') {
+      options->files.push_back(arg);
+      continue;
+    }
+    // Options that take a value accept it attached or as the next argument.
+    auto value = [&](const char* name, std::string* out) {
+      size_t length = std::strlen(name);
+      if (arg.compare(0, length, name) != 0) {
+        return false;
+      }
+      if (arg.size() > length) {
+        *out = arg.substr(length + (arg[length] == '=' ? 1 : 0));
+      } else if (i + 1 < argc) {
+        *out = argv[++i];
+      } else {
+        *out = "";
+      }
+      return true;
+    };
+    std::string text;
+    if (arg == "--") {
+      literal = true;
+    } else if (value("--algorithm", &text) || value("-a", &text)) {
+      if (!parse_algorithm(text, &options->algorithm)) {
+        std::cerr << PROGRAM << ": unrecognized algorithm '" << text << "'"
+                  << std::endl;
+        return false;
+      }
+      options->algorithm_set = true;
+    } else if (value("--jobs", &text) || value("-j", &text)) {
+      char* end;
+      long jobs = std::strtol(text.c_str(), &end, 10);
+      if (text.empty() || *end != '\0' || jobs < 1) {
+        std::cerr << PROGRAM << ": invalid number of jobs '" << text << "'"
+                  << std::endl;
+        return false;
+      }
+      options->jobs = static_cast<size_t>(jobs);
+    } else if (arg == "-b" || arg == "--binary") {
+      options->binary = true;
+    } else if (arg == "-t" || arg == "--text") {
+      options->binary = false;
+    } else if (arg == "-c" || arg == "--check") {
+      options->check = true;
+    } else if (arg == "--quiet") {
+      options->quiet = true;
+    } else if (arg == "--status") {
+      options->status = true;
+    } else {
+      if (arg != "-h" && arg != "--help") {
+        std::cerr << PROGRAM << ": unrecognized option '" << arg << "'"
+                  << std::endl;
+        return false;
+      }
+      usage(std::cout);
+      std::exit(0);
+    }
+  }
+  if (options->files.empty()) {
+    options->files.push_back("-");
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parse_options(argc, argv, &options)) {
+    usage(std::cerr);
+    return 2;
+  }
+  int status = options.check ? check_manifests(options)
+                             : print_digests(options);
+  std::cout.flush();
+  return status;
+}